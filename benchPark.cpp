@@ -0,0 +1,113 @@
+/*
+ * Park path benchmark.
+ *
+ * Measures ParkVehicleInSpot throughput and the number of SQLite statements
+ *  each call runs, for successful parks, buses and parks rejected because
+ *  the spot is full.
+ */
+#include "garageApi.hpp"
+#include "garageLog.hpp"
+
+#include <sqlite3.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+static uint64_t statementCount = 0;
+
+static int countStatement(unsigned type, void *context, void *p, void *x)
+{
+    statementCount++;
+    return 0;
+}
+
+static void report(const char *name, size_t calls, uint64_t statements, std::chrono::steady_clock::time_point start)
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("| %s | %.0f | %.1f |\n", name, calls / seconds, static_cast<double>(statements) / calls);
+}
+
+int main(int argc, char **argv)
+{
+    std::string profile_name = "ephemeral";
+    if (argc >= 2)
+    {
+        profile_name = std::string(argv[1]);
+    }
+    GarageConfig_t config;
+    if (GarageConfigFromName(profile_name, config) != GarageRetCode::OK)
+    {
+        return 1;
+    }
+    const std::string db_path = "./garages_bench.db3";
+    remove(db_path.c_str());
+    sqlite3 *db;
+    if (OpenGarageDb(db_path, config, &db) != GarageRetCode::OK)
+    {
+        return 1;
+    }
+    GarageLogger::Instance().SetLevel(LogLevel::LOG_NONE);
+    GarageApi *api = new GarageApi(db, config);
+    GarageInfo_t garage_info;
+    api->CreateGarage(4, 30, 50, garage_info);
+    std::vector<int> spot_ids(garage_info.spotsVacant.begin(), garage_info.spotsVacant.end());
+    // Buses park at the start of each run of 5 large spots
+    std::vector<int> bus_spot_ids{};
+    std::vector<int> other_spot_ids{};
+    for (int spot_id : spot_ids)
+    {
+        ParkingSpotInfo_t spot;
+        api->GetParkingSpotInfo(spot_id, spot);
+        if (spot.spotType == SpotType::SPOT_LARGE)
+        {
+            if (spot.spotNum % 5 == 0)
+            {
+                bus_spot_ids.push_back(spot_id);
+            }
+        }
+        else
+        {
+            other_spot_ids.push_back(spot_id);
+        }
+    }
+    sqlite3_trace_v2(db, SQLITE_TRACE_STMT, countStatement, NULL);
+
+    printf("| Park (%s) | Parks/s | Statements/park |\n", profile_name.c_str());
+    printf("|---|---:|---:|\n");
+    VehicleInfo_t motorcycle = {VehicleType::VEHICLE_MOTORCYCLE};
+    VehicleInfo_t bus = {VehicleType::VEHICLE_BUS};
+
+    statementCount = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int spot_id : other_spot_ids)
+    {
+        api->ParkVehicleInSpot(motorcycle, spot_id);
+    }
+    report("motorcycle", other_spot_ids.size(), statementCount, start);
+
+    statementCount = 0;
+    start = std::chrono::steady_clock::now();
+    for (int spot_id : bus_spot_ids)
+    {
+        api->ParkVehicleInSpot(bus, spot_id);
+    }
+    report("bus", bus_spot_ids.size(), statementCount, start);
+
+    statementCount = 0;
+    start = std::chrono::steady_clock::now();
+    for (int spot_id : other_spot_ids)
+    {
+        api->ParkVehicleInSpot(motorcycle, spot_id);
+    }
+    report("rejected (spot full)", other_spot_ids.size(), statementCount, start);
+
+    delete api;
+    sqlite3_close(db);
+    remove(db_path.c_str());
+    remove((db_path + "-wal").c_str());
+    remove((db_path + "-shm").c_str());
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Durability profile benchmark.
+ *
+ * Creates a garage and parks a motorcycle in every spot under each profile,
+ *  then prints the throughput of both phases as a markdown table.
+ */
+#include "garageApi.hpp"
+#include "garageLog.hpp"
+
+#include <sqlite3.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    std::string db_path = "./garages_bench.db3";
+    if (argc >= 2)
+    {
+        db_path = std::string(argv[1]);
+    }
+    const uint levels = 4;
+    const uint rows_per_level = 10;
+    const uint spots_per_row = 50;
+    const char *profile_names[] = {"strict", "balanced", "ephemeral", "bulk-load"};
+    const char *durability[] = {
+        "every commit fsynced",
+        "survives crash, may lose last commits on power loss",
+        "lost on exit",
+        "loses open batch on crash, may corrupt on power loss",
+    };
+
+    std::cout << "| Profile | Create spots/s | Parks/s | Durability |" << std::endl;
+    std::cout << "|---|---:|---:|---|" << std::endl;
+    for (int i = 0; i < 4; i++)
+    {
+        GarageConfig_t config;
+        GarageConfigFromName(profile_names[i], config);
+        remove(db_path.c_str());
+        remove((db_path + "-wal").c_str());
+        remove((db_path + "-shm").c_str());
+        sqlite3 *db;
+        if (OpenGarageDb(db_path, config, &db) != GarageRetCode::OK)
+        {
+            return 1;
+        }
+        GarageApi *api = new GarageApi(db, config);
+
+        auto start = std::chrono::steady_clock::now();
+        GarageInfo_t garage_info;
+        if (api->CreateGarage(levels, rows_per_level, spots_per_row, garage_info) != GarageRetCode::OK)
+        {
+            return 1;
+        }
+        api->Commit();
+        double create_seconds = secondsSince(start);
+
+        std::vector<int> spot_ids(garage_info.spotsVacant.begin(), garage_info.spotsVacant.end());
+        VehicleInfo_t motorcycle = {VehicleType::VEHICLE_MOTORCYCLE};
+        start = std::chrono::steady_clock::now();
+        for (int spot_id : spot_ids)
+        {
+            api->ParkVehicleInSpot(motorcycle, spot_id);
+        }
+        api->Commit();
+        double park_seconds = secondsSince(start);
+
+        printf("| %s | %.0f | %.0f | %s |\n", profile_names[i],
+            spot_ids.size() / create_seconds, spot_ids.size() / park_seconds, durability[i]);
+        fflush(stdout);
+        delete api;
+        sqlite3_close(db);
+    }
+    remove(db_path.c_str());
+    remove((db_path + "-wal").c_str());
+    remove((db_path + "-shm").c_str());
+    GarageLogger::Instance().Flush();
+    return 0;
+}
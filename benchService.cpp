@@ -0,0 +1,93 @@
+/*
+ * Sharded service benchmark.
+ *
+ * For 1, 2, 4, ... shards up to the number of cores, creates one garage per
+ *  shard and parks a motorcycle in every spot from one client thread per
+ *  garage, then prints the total throughput as a markdown table.
+ */
+#include "garageApi.hpp"
+#include "garageLog.hpp"
+#include "garageService.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+int main(int argc, char **argv)
+{
+    std::string profile_name = "ephemeral";
+    if (argc >= 2)
+    {
+        profile_name = std::string(argv[1]);
+    }
+    GarageConfig_t config;
+    if (GarageConfigFromName(profile_name, config) != GarageRetCode::OK)
+    {
+        return 1;
+    }
+    uint max_shards = std::thread::hardware_concurrency();
+    if (argc >= 3)
+    {
+        max_shards = std::stoi(argv[2]);
+    }
+    GarageLogger::Instance().SetLevel(LogLevel::LOG_NONE);
+
+    printf("| Shards (%s, %u cores) | Parks/s | Speedup |\n", profile_name.c_str(), std::thread::hardware_concurrency());
+    printf("|---:|---:|---:|\n");
+    double single_shard_rate = 0;
+    for (uint num_shards = 1; num_shards <= max_shards; num_shards *= 2)
+    {
+        GarageRetCode ret_code;
+        GarageService service(num_shards, config, "./garages_bench", &ret_code);
+        if (ret_code != GarageRetCode::OK)
+        {
+            return 1;
+        }
+        service.Reset();
+        std::vector<std::vector<int>> spot_ids(num_shards);
+        for (uint shard = 0; shard < num_shards; shard++)
+        {
+            GarageInfo_t garage_info;
+            service.CreateGarage(4, 30, 50, garage_info);
+            spot_ids[shard].assign(garage_info.spotsVacant.begin(), garage_info.spotsVacant.end());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for (uint shard = 0; shard < num_shards; shard++)
+        {
+            clients.emplace_back([&, shard]() {
+                VehicleInfo_t motorcycle = {VehicleType::VEHICLE_MOTORCYCLE};
+                for (int spot_id : spot_ids[shard])
+                {
+                    service.ParkVehicleInSpot(motorcycle, spot_id);
+                }
+            });
+        }
+        size_t num_parks = 0;
+        for (uint shard = 0; shard < num_shards; shard++)
+        {
+            clients[shard].join();
+            num_parks += spot_ids[shard].size();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rate = num_parks / seconds;
+        if (num_shards == 1)
+        {
+            single_shard_rate = rate;
+        }
+        printf("| %u | %.0f | %.2fx |\n", num_shards, rate, rate / single_shard_rate);
+        fflush(stdout);
+    }
+    for (uint shard = 0; shard < max_shards; shard++)
+    {
+        std::string db_path = "./garages_bench." + std::to_string(shard) + ".db3";
+        remove(db_path.c_str());
+        remove((db_path + "-wal").c_str());
+        remove((db_path + "-shm").c_str());
+    }
+    return 0;
+}
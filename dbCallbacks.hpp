@@ -5,15 +5,17 @@
  */
 #pragma once
 
+#include "garageLog.hpp"
+#include "occupancyBoard.hpp"
+
 #include <string>
-#include <iostream>
 
 
 static int dbCallbackGetGarageInfo(void *pGarageInfo, int count, char **data, char **columns)
 {
     if (count != 4)
     {
-        std::cout << "ERR: dbCallbackGetGarageInfo: Schema was updated and count is invalid." << std::endl;
+        GARAGE_LOG(LOG_ERROR, "dbCallbackGetGarageInfo: Schema was updated and count is invalid.");
         return -1;
     }
     GarageInfo_t *garage = static_cast<GarageInfo_t*>(pGarageInfo);
@@ -24,34 +26,26 @@ static int dbCallbackGetGarageInfo(void *pGarageInfo, int count, char **data, ch
     return 0;
 }
 
-static int dbCallbackGetGarageInfoVector(void *pSpots, int count, char **data, char **columns)
+static int dbCallbackGetGarageInfoSpots(void *pSpots, int count, char **data, char **columns)
 {
     if (count != 1)
     {
-        std::cout << "ERR: dbCallbackGetGarageInfoVector: Schema was updated and count is invalid." << std::endl;
+        GARAGE_LOG(LOG_ERROR, "dbCallbackGetGarageInfoSpots: Schema was updated and count is invalid.");
         return -1;
     }
-    std::vector<int> *spots = static_cast<std::vector<int>*>(pSpots);
-    spots->push_back(std::stoi(data[0]));
+    SpotBitmap *spots = static_cast<SpotBitmap*>(pSpots);
+    spots->add(std::stoi(data[0]));
     return 0;
 }
 
-static int dbCallbackGetParkingSpotInfo(void *pParkingSpotInfo, int count, char **data, char **columns)
+static int dbCallbackGetInt64(void *pValue, int count, char **data, char **columns)
 {
-    if (count != 7)
+    if (count != 1)
     {
-        std::cout << "ERR: dbCallbackGetParkingSpotInfo: Schema was updated and count is invalid." << std::endl;
+        GARAGE_LOG(LOG_ERROR, "dbCallbackGetInt64: Schema was updated and count is invalid.");
         return -1;
     }
-    ParkingSpotInfo_t *parking_spot = static_cast<ParkingSpotInfo_t*>(pParkingSpotInfo);
-    parking_spot->id = std::stoi(data[0]);
-    parking_spot->spotType = static_cast<SpotType>(std::stoi(data[1]));
-    parking_spot->parkedVehicle = (data[2] == nullptr) ? VEHICLE_NONE : static_cast<VehicleType>(std::stoi(data[2]));
-    parking_spot->isVacant = (data[2] == nullptr) ? true : false;
-    parking_spot->garageId = std::stoi(data[3]);
-    parking_spot->level = std::stoi(data[4]);
-    parking_spot->row = std::stoi(data[5]);
-    parking_spot->spotNum = std::stoi(data[6]);
+    *static_cast<int64_t*>(pValue) = std::stoll(data[0]);
     return 0;
 }
 
@@ -59,7 +53,7 @@ static int dbCallbackGetVacantParkingSpot(void *pVacantSpots, int count, char **
 {
     if (count != 4)
     {
-        std::cout << "ERR: dbCallbackGetVacantParkingSpot: Schema was updated and count is invalid." << std::endl;
+        GARAGE_LOG(LOG_ERROR, "dbCallbackGetVacantParkingSpot: Schema was updated and count is invalid.");
         return -1;
     }
     std::vector<ParkingSpotInfo_t> *vacant_spots = static_cast<std::vector<ParkingSpotInfo_t>*>(pVacantSpots);
@@ -72,14 +66,32 @@ static int dbCallbackGetVacantParkingSpot(void *pVacantSpots, int count, char **
     return 0;
 }
 
-static int dbCallbackCheckParkingSpotBus(void *pSpots, int count, char **data, char **columns)
+static void dbStatementGetParkingSpotInfo(sqlite3_stmt *stmt, ParkingSpotInfo_t &parkingSpot)
 {
-    if (count != 1)
+    // Columns must match the parking_spots table order, as with SELECT *
+    parkingSpot.id = sqlite3_column_int(stmt, 0);
+    parkingSpot.spotType = static_cast<SpotType>(sqlite3_column_int(stmt, 1));
+    parkingSpot.isVacant = (sqlite3_column_type(stmt, 2) == SQLITE_NULL);
+    parkingSpot.parkedVehicle = parkingSpot.isVacant ? VEHICLE_NONE : static_cast<VehicleType>(sqlite3_column_int(stmt, 2));
+    parkingSpot.garageId = sqlite3_column_int(stmt, 3);
+    parkingSpot.level = sqlite3_column_int(stmt, 4);
+    parkingSpot.row = sqlite3_column_int(stmt, 5);
+    parkingSpot.spotNum = sqlite3_column_int(stmt, 6);
+}
+
+static int dbCallbackGetOccupancyCounts(void *pCounts, int count, char **data, char **columns)
+{
+    if (count != 4)
     {
-        std::cout << "ERR: dbCallbackCheckParkingSpotBus: Schema was updated and count is invalid." << std::endl;
+        GARAGE_LOG(LOG_ERROR, "dbCallbackGetOccupancyCounts: Schema was updated and count is invalid.");
         return -1;
     }
-    std::vector<int> *spots = static_cast<std::vector<int>*>(pSpots);
-    spots->push_back(std::stoi(data[0]));
+    std::vector<BoardCount_t> *counts = static_cast<std::vector<BoardCount_t>*>(pCounts);
+    BoardCount_t board_count;
+    board_count.level = std::stoi(data[0]);
+    board_count.spotType = static_cast<SpotType>(std::stoi(data[1]));
+    board_count.spots = std::stoi(data[2]);
+    board_count.vacant = board_count.spots - std::stoi(data[3]);
+    counts->push_back(board_count);
     return 0;
 }
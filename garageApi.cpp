@@ -1,15 +1,98 @@
 #include "garageApi.hpp"
 #include "dbCallbacks.hpp"
+#include "garageLog.hpp"
+#include "occupancyBoard.hpp"
+#include "occupancyRecorder.hpp"
+#include "vehicleClasses.hpp"
 
-#include <iostream>
+#include <algorithm>
 
 
-GarageApi::GarageApi(sqlite3 *db):
-    _db(db)
+GarageConfig_t GarageConfigForProfile(DurabilityProfile profile)
 {
+    GarageConfig_t config;
+    config.profile = profile;
+    switch (profile)
+    {
+        case DurabilityProfile::PROFILE_STRICT:
+            // SQLite defaults
+            break;
+        case DurabilityProfile::PROFILE_BALANCED:
+            config.journalMode = "WAL";
+            config.synchronous = "NORMAL";
+            config.cacheSizeKb = 16384;
+            config.mmapSize = 256L * 1024 * 1024;
+            break;
+        case DurabilityProfile::PROFILE_EPHEMERAL:
+            config.journalMode = "MEMORY";
+            config.synchronous = "OFF";
+            config.cacheSizeKb = 16384;
+            config.tempStoreMemory = true;
+            config.inMemory = true;
+            break;
+        case DurabilityProfile::PROFILE_BULK_LOAD:
+            config.journalMode = "MEMORY";
+            config.synchronous = "OFF";
+            config.cacheSizeKb = 65536;
+            config.mmapSize = 256L * 1024 * 1024;
+            config.tempStoreMemory = true;
+            config.commitBatchSize = 1000;
+            break;
+    }
+    return config;
+}
+
+GarageRetCode GarageConfigFromName(const std::string &name, GarageConfig_t &config)
+{
+    if (name == "strict")
+    {
+        config = GarageConfigForProfile(DurabilityProfile::PROFILE_STRICT);
+    }
+    else if (name == "balanced")
+    {
+        config = GarageConfigForProfile(DurabilityProfile::PROFILE_BALANCED);
+    }
+    else if (name == "ephemeral")
+    {
+        config = GarageConfigForProfile(DurabilityProfile::PROFILE_EPHEMERAL);
+    }
+    else if (name == "bulk-load")
+    {
+        config = GarageConfigForProfile(DurabilityProfile::PROFILE_BULK_LOAD);
+    }
+    else
+    {
+        return GarageRetCode::ERR_INVALID_ARGUMENTS;
+    }
+    return GarageRetCode::OK;
+}
+
+GarageRetCode OpenGarageDb(const std::string &path, const GarageConfig_t &config, sqlite3 **db)
+{
+    std::string db_path = config.inMemory ? ":memory:" : path;
+    int db_ret_code = sqlite3_open(db_path.c_str(), db);
+    if (db_ret_code != SQLITE_OK)
+    {
+        GARAGE_LOG(LOG_ERROR, "Can't open database file %s: %s", db_path.c_str(), sqlite3_errmsg(*db));
+        return GarageRetCode::ERR_DATABASE;
+    }
+    return GarageRetCode::OK;
+}
+
+GarageApi::GarageApi(sqlite3 *db, GarageConfig_t config):
+    _db(db),
+    _config(config)
+{
+    _applyConfig();
     _createDbTables();
 }
 
+GarageApi::~GarageApi()
+{
+    Commit();
+    _finalizeStatements();
+}
+
 GarageRetCode GarageApi::CreateGarage(uint levels, uint rowsPerLevel, uint spotsPerRow, GarageInfo_t &garageInfo)
 {
     // ASSUMPTION: Each row contains spots of all the same type.
@@ -19,8 +102,14 @@ GarageRetCode GarageApi::CreateGarage(uint levels, uint rowsPerLevel, uint spots
     {
         return GarageRetCode::ERR_INVALID_ARGUMENTS;
     }
+    GarageRetCode ret_code = _checkIdLimit(static_cast<int64_t>(levels) * rowsPerLevel * spotsPerRow);
+    if (ret_code != GarageRetCode::OK)
+    {
+        return ret_code;
+    }
 
-    // Create new garage and grab id
+    // Create the garage and its spots in a single transaction
+    _start_transaction();
     std::string sql_statement = ""
         "INSERT INTO garages("
         "levels, rows_per_level, spots_per_row"
@@ -32,10 +121,11 @@ GarageRetCode GarageApi::CreateGarage(uint levels, uint rowsPerLevel, uint spots
     int db_ret_code = _run_sql_command(sql_statement);
     if (db_ret_code != 0)
     {
+        _rollback_transaction();
+        _end_transaction();
         return GarageRetCode::ERR_DATABASE;
     }
     int garage_id = sqlite3_last_insert_rowid(_db);
-    // Create spots for new garage
     for (int level = 0; level < levels; level++)
     {
         std::vector<SpotType> spot_types{};
@@ -44,12 +134,10 @@ GarageRetCode GarageApi::CreateGarage(uint levels, uint rowsPerLevel, uint spots
             // Reset spot type vector when empty
             if (spot_types.empty())
             {
-                spot_types.push_back(SpotType::SPOT_MOTORCYCLE);
-                spot_types.push_back(SpotType::SPOT_COMPACT);
-                spot_types.push_back(SpotType::SPOT_LARGE);
+                spot_types.assign(std::begin(GARAGE_SPOT_TYPES), std::end(GARAGE_SPOT_TYPES));
             }
             // Pull "random" spot type from vector
-            uint index = spot_types.size() > 1 ? rand() % (spot_types.size() - 1) : 0;
+            uint index = spot_types.size() > 1 ? _spotTypeRng() % (spot_types.size() - 1) : 0;
             SpotType spot_type = spot_types.at(index);
             spot_types.erase(spot_types.begin() + index);
             // Create row of spots of the pulled type
@@ -57,16 +145,24 @@ GarageRetCode GarageApi::CreateGarage(uint levels, uint rowsPerLevel, uint spots
             {
                 // Create spot @ level, row, spot_num of specified spot type in newly created garage
                 // e.g. level 2, row 5, spot 1, type LARGE, garage 3
-                GarageRetCode ret_code = _createSpot(garage_id, level, row, spot_num, spot_type);
+                ret_code = _createSpot(garage_id, level, row, spot_num, spot_type);
                 if (ret_code != GarageRetCode::OK)
                 {
+                    // Leave no half-built garage behind
+                    _rollback_transaction();
+                    _end_transaction();
                     return ret_code;
                 }
             }
         }
     }
+    _end_transaction();
+    if (_recorder != nullptr || _board != nullptr)
+    {
+        _publishGarageOccupancy(garage_id);
+    }
     // Fill in return info
-    GarageRetCode ret_code = GetGarageInfo(garage_id, garageInfo);
+    ret_code = GetGarageInfo(garage_id, garageInfo);
     return ret_code;
 }
 
@@ -92,8 +188,8 @@ GarageRetCode GarageApi::GetGarageInfo(int garageId, GarageInfo_t &garageInfo)
         " WHERE"
         " garage_id = " + std::to_string(garageId) +
         " AND parked_vehicle IS NULL";
-    std::vector<int> spots_vacant{};
-    db_ret_code = _run_sql_command(sql_statement, dbCallbackGetGarageInfoVector, &spots_vacant);
+    SpotBitmap spots_vacant{};
+    db_ret_code = _run_sql_command(sql_statement, dbCallbackGetGarageInfoSpots, &spots_vacant);
     if (db_ret_code != 0)
     {
         return GarageRetCode::ERR_DATABASE;
@@ -105,16 +201,45 @@ GarageRetCode GarageApi::GetGarageInfo(int garageId, GarageInfo_t &garageInfo)
         " WHERE"
         " garage_id = " + std::to_string(garageId) +
         " AND parked_vehicle IS NOT NULL";
-    std::vector<int> spots_filled{};
-    db_ret_code = _run_sql_command(sql_statement, dbCallbackGetGarageInfoVector, &spots_filled);
+    SpotBitmap spots_filled{};
+    db_ret_code = _run_sql_command(sql_statement, dbCallbackGetGarageInfoSpots, &spots_filled);
     if (db_ret_code != 0)
     {
         return GarageRetCode::ERR_DATABASE;
     }
 
     // Basic garage info is filled in during dbCallbackGetGarageInfo    
-    garageInfo.spotsVacant = spots_vacant;
-    garageInfo.spotsFilled = spots_filled;
+    spots_vacant.runOptimize();
+    spots_filled.runOptimize();
+    garageInfo.spotsVacant = std::move(spots_vacant);
+    garageInfo.spotsFilled = std::move(spots_filled);
+    return GarageRetCode::OK;
+}
+
+GarageRetCode GarageApi::GetGarageSpots(int garageId, int level, SpotType spotType, SpotBitmap &spots)
+{
+    std::string sql_statement = ""
+        "SELECT id"
+        " FROM parking_spots"
+        " WHERE"
+        " garage_id = " + std::to_string(garageId);
+    if (level >= 0)
+    {
+        sql_statement += " AND level = " + std::to_string(level);
+    }
+    if (spotType != SpotType::SPOT_NONE)
+    {
+        sql_statement += " AND spot_type = " + std::to_string(spotType);
+    }
+    SpotBitmap matching_spots{};
+    int db_ret_code = _run_sql_command(sql_statement, dbCallbackGetGarageInfoSpots, &matching_spots);
+    if (db_ret_code != 0)
+    {
+        return GarageRetCode::ERR_DATABASE;
+    }
+
+    matching_spots.runOptimize();
+    spots = std::move(matching_spots);
     return GarageRetCode::OK;
 }
 
@@ -124,15 +249,30 @@ GarageRetCode GarageApi::GetParkingSpotInfo(int parkingSpotId, ParkingSpotInfo_t
     {
         return GarageRetCode::ERR_INVALID_ID;
     }
-    std::string sql_statement = ""
-        "SELECT *"
-        " FROM parking_spots"
-        " WHERE id=" + std::to_string(parkingSpotId);
+    // A single SELECT is consistent on its own, so no transaction is needed
+    if (_spotInfoStmt == nullptr)
+    {
+        std::string sql_statement = ""
+            "SELECT *"
+            " FROM parking_spots"
+            " WHERE id = ?1";
+        if (_prepare_sql_statement(sql_statement, &_spotInfoStmt) != SQLITE_OK)
+        {
+            return GarageRetCode::ERR_DATABASE;
+        }
+    }
+    sqlite3_bind_int(_spotInfoStmt, 1, parkingSpotId);
     ParkingSpotInfo_t parking_spot;
-    int db_ret_code = _run_sql_command(sql_statement, dbCallbackGetParkingSpotInfo, &parking_spot);
-    if (db_ret_code != 0)
+    int db_ret_code = sqlite3_step(_spotInfoStmt);
+    if (db_ret_code == SQLITE_ROW)
     {
-        std::cout << "Failure running sqlite3 command: " << sql_statement << std::endl;
+        dbStatementGetParkingSpotInfo(_spotInfoStmt, parking_spot);
+        db_ret_code = sqlite3_step(_spotInfoStmt);
+    }
+    sqlite3_reset(_spotInfoStmt);
+    if (db_ret_code != SQLITE_DONE)
+    {
+        GARAGE_LOG(LOG_ERROR, "Failure reading parking spot %d: %s", parkingSpotId, sqlite3_errmsg(_db));
         return GarageRetCode::ERR_DATABASE;
     }
 
@@ -140,17 +280,114 @@ GarageRetCode GarageApi::GetParkingSpotInfo(int parkingSpotId, ParkingSpotInfo_t
     return GarageRetCode::OK;
 }
 
+GarageRetCode GarageApi::GetSpotPage(int garageId, SpotFilter_t filter, int token, uint pageSize, std::vector<ParkingSpotInfo_t> &page, int &nextToken)
+{
+    page.clear();
+    if (token == SPOT_CURSOR_DONE)
+    {
+        nextToken = SPOT_CURSOR_DONE;
+        return GarageRetCode::OK;
+    }
+    if (token < 0 || pageSize == 0U)
+    {
+        return GarageRetCode::ERR_INVALID_ARGUMENTS;
+    }
+    // Prepared once and re-bound for every page. The (garage_id, id) index
+    //  matches the keyset order, so each page seeks past the token and reads
+    //  forward instead of scanning and sorting the whole garage.
+    if (_spotPageStmt == nullptr)
+    {
+        std::string sql_statement = ""
+            "SELECT *"
+            " FROM parking_spots"
+            " WHERE"
+            " garage_id = ?1"
+            " AND id > ?2"
+            " AND (?3 < 0 OR level = ?3)"
+            " AND (?4 = " + std::to_string(SpotType::SPOT_NONE) + " OR spot_type = ?4)"
+            " AND (?5 = " + std::to_string(SpotOccupancy::OCCUPANCY_ANY) +
+            "  OR (?5 = " + std::to_string(SpotOccupancy::OCCUPANCY_VACANT) + " AND parked_vehicle IS NULL)"
+            "  OR (?5 = " + std::to_string(SpotOccupancy::OCCUPANCY_FILLED) + " AND parked_vehicle IS NOT NULL))"
+            " ORDER BY id ASC"
+            " LIMIT ?6";
+        if (_prepare_sql_statement(sql_statement, &_spotPageStmt) != SQLITE_OK)
+        {
+            return GarageRetCode::ERR_DATABASE;
+        }
+    }
+    sqlite3_bind_int(_spotPageStmt, 1, garageId);
+    sqlite3_bind_int(_spotPageStmt, 2, token);
+    sqlite3_bind_int(_spotPageStmt, 3, filter.level);
+    sqlite3_bind_int(_spotPageStmt, 4, filter.spotType);
+    sqlite3_bind_int(_spotPageStmt, 5, filter.occupancy);
+    sqlite3_bind_int(_spotPageStmt, 6, pageSize);
+
+    page.reserve(pageSize);
+    int db_ret_code;
+    while ((db_ret_code = sqlite3_step(_spotPageStmt)) == SQLITE_ROW)
+    {
+        ParkingSpotInfo_t parking_spot;
+        dbStatementGetParkingSpotInfo(_spotPageStmt, parking_spot);
+        page.push_back(parking_spot);
+    }
+    sqlite3_reset(_spotPageStmt);
+    if (db_ret_code != SQLITE_DONE)
+    {
+        GARAGE_LOG(LOG_ERROR, "Failure stepping sqlite3 statement: %s", sqlite3_errmsg(_db));
+        page.clear();
+        return GarageRetCode::ERR_DATABASE;
+    }
+
+    // A short page means the table is exhausted
+    nextToken = (page.size() < pageSize) ? SPOT_CURSOR_DONE : page.back().id;
+    return GarageRetCode::OK;
+}
+
+GarageRetCode GarageApi::ForEachSpot(int garageId, SpotFilter_t filter, std::function<bool(const ParkingSpotInfo_t&)> callback)
+{
+    SpotCursor cursor(this, garageId, filter);
+    std::vector<ParkingSpotInfo_t> page{};
+    while (!cursor.Done())
+    {
+        GarageRetCode ret_code = cursor.Next(page);
+        if (ret_code != GarageRetCode::OK)
+        {
+            return ret_code;
+        }
+        for (const ParkingSpotInfo_t &parking_spot : page)
+        {
+            if (!callback(parking_spot))
+            {
+                return GarageRetCode::OK;
+            }
+        }
+    }
+    return GarageRetCode::OK;
+}
+
 GarageRetCode GarageApi::ParkVehicleInGarage(VehicleInfo_t vehicle, int garageId, int &parkingSpotId)
 {
+    const VehicleClass_t *vehicle_class = FindVehicleClass(vehicle.vehicleType);
+    if (vehicle_class == nullptr)
+    {
+        GARAGE_LOG(LOG_WARN, "Invalid VehicleType: %d", vehicle.vehicleType);
+        return GarageRetCode::ERR_INVALID_VEHICLE_TYPE;
+    }
+
     // Get open spot for type
-    int spot_id = _getVacantSpotId(vehicle.vehicleType);
-    if (spot_id < 0)
+    int spot_id = -1;
+    GarageRetCode ret_code = _getVacantSpotId(garageId, *vehicle_class, spot_id);
+    if (ret_code != GarageRetCode::OK)
+    {
+        return ret_code;
+    }
+    else if (spot_id < 0)
     {
         return GarageRetCode::ERR_NO_VACANT_SPOT;
     }
 
     // Park vehicle in spot
-    GarageRetCode ret_code = ParkVehicleInSpot(vehicle, spot_id);
+    ret_code = ParkVehicleInSpot(vehicle, spot_id);
     if (ret_code == GarageRetCode::OK)
     {
         parkingSpotId = spot_id;
@@ -164,50 +401,119 @@ GarageRetCode GarageApi::ParkVehicleInSpot(VehicleInfo_t vehicle, int parkingSpo
     {
         return GarageRetCode::ERR_INVALID_ID;
     }
-    ParkingSpotInfo_t parking_spot;
-    GarageRetCode ret_code = GetParkingSpotInfo(parkingSpotId, parking_spot);
+
+    const VehicleClass_t *vehicle_class = FindVehicleClass(vehicle.vehicleType);
+    if (vehicle_class == nullptr)
+    {
+        GARAGE_LOG(LOG_WARN, "Invalid VehicleType: %d", vehicle.vehicleType);
+        return GarageRetCode::ERR_INVALID_VEHICLE_TYPE;
+    }
+    int footprint = vehicle_class->footprint;
+
+    // Compare-and-set: the UPDATE only matches if every spot is still vacant
+    //  and compatible, so no read is needed before it and no other write can
+    //  slip in between the check and the update.
+    int changes = 0;
+    int db_ret_code = _dbParkVehicle(parkingSpotId, vehicle.vehicleType, vehicle_class->allowedSpotTypes, footprint, changes);
+    if (db_ret_code != SQLITE_OK)
+    {
+        return GarageRetCode::ERR_DATABASE;
+    }
+    if (changes == footprint)
+    {
+        if (_recorder != nullptr || _board != nullptr)
+        {
+            _recordPark(parkingSpotId, footprint);
+        }
+        return GarageRetCode::OK;
+    }
+
+    // Failure path only: read the whole footprint back to report why, so a
+    //  vehicle blocked by any filled spot gets ERR_SPOT_FULL
+    std::vector<ParkingSpotInfo_t> parking_spots{};
+    GarageRetCode ret_code = _getFootprintSpots(parkingSpotId, footprint, parking_spots);
     if (ret_code != GarageRetCode::OK)
     {
         return ret_code;
     }
-    else if (parking_spot.spotType == SpotType::SPOT_NONE)
+    else if (parking_spots.empty())
     {
-        std::cout << "Invalid SpotType: " << parking_spot.spotType << std::endl;
+        GARAGE_LOG(LOG_WARN, "Invalid SpotType: %d", SpotType::SPOT_NONE);
         return GarageRetCode::ERR_INVALID_SPOT_TYPE;
     }
-    else if (!parking_spot.isVacant)
+    for (const ParkingSpotInfo_t &parking_spot : parking_spots)
     {
-        std::cout << "Cannot park in spot (" << std::to_string(parkingSpotId) << "): Spot full!" << std::endl;
-        return GarageRetCode::ERR_SPOT_FULL;
+        if (!parking_spot.isVacant)
+        {
+            GARAGE_LOG(LOG_INFO, "Cannot park in spot (%d): Spot full!", parkingSpotId);
+            return GarageRetCode::ERR_SPOT_FULL;
+        }
     }
+    return GarageRetCode::ERR_INVALID_SPOT;
+}
 
-    // Check type compatibility
-    switch (vehicle.vehicleType)
+GarageRetCode GarageApi::_publishGarageOccupancy(int garageId)
+{
+    std::string sql_statement = ""
+        "SELECT level, spot_type, COUNT(*), COUNT(parked_vehicle)"
+        " FROM parking_spots"
+        " WHERE garage_id = " + std::to_string(garageId) +
+        " GROUP BY level, spot_type";
+    std::vector<BoardCount_t> counts{};
+    int db_ret_code = _run_sql_command(sql_statement, dbCallbackGetOccupancyCounts, &counts);
+    if (db_ret_code != 0)
     {
-        case VehicleType::VEHICLE_MOTORCYCLE:
-            // Motorcycles can park anywhere
-            break;
-        case VehicleType::VEHICLE_CAR:
-            // Cars cannot park in motorcycle spots
-            if (parking_spot.spotType == SpotType::SPOT_MOTORCYCLE)
-            {
-                ret_code = GarageRetCode::ERR_INVALID_SPOT;
-            }
-            break;
-        case VehicleType::VEHICLE_BUS:
-            // Busses have multiple conditions, see function
-            ret_code = _checkParkingSpotBus(parking_spot);
-            break;
-        default:
-            std::cout << "Invalid VehicleType: " << vehicle.vehicleType << std::endl;
-            ret_code = GarageRetCode::ERR_INVALID_VEHICLE_TYPE;
+        return GarageRetCode::ERR_DATABASE;
+    }
+    uint levels = 0;
+    for (const BoardCount_t &count : counts)
+    {
+        levels = std::max(levels, count.level + 1);
+        if (_recorder != nullptr)
+        {
+            _recorder->Set(garageId, count.level, count.spotType, count.spots - count.vacant);
+        }
     }
+    if (_board != nullptr && _unpublishedGarages.count(garageId) == 0)
+    {
+        GarageRetCode ret_code = _board->PublishGarage(garageId, levels, counts);
+        if (ret_code == GarageRetCode::ERR_SHARED_MEMORY)
+        {
+            // Full until Reset, so don't retry on every park
+            _unpublishedGarages.insert(garageId);
+        }
+        return ret_code;
+    }
+    return GarageRetCode::OK;
+}
 
-    if (ret_code == GarageRetCode::OK)
+GarageRetCode GarageApi::_checkIdLimit(int64_t numSpots)
+{
+    if (_config.idLimit <= 0)
     {
-        ret_code = _dbUpdateParkingSpot(parkingSpotId, vehicle.vehicleType);
+        return GarageRetCode::OK;
     }
-    return ret_code;
+    // AUTOINCREMENT hands out the ids right after the last ones used
+    int64_t last_garage_id = _config.idBase;
+    int64_t last_spot_id = _config.idBase;
+    std::string sql_statement = "SELECT seq FROM sqlite_sequence WHERE name = 'garages'";
+    int db_ret_code = _run_sql_command(sql_statement, dbCallbackGetInt64, &last_garage_id);
+    if (db_ret_code != 0)
+    {
+        return GarageRetCode::ERR_DATABASE;
+    }
+    sql_statement = "SELECT seq FROM sqlite_sequence WHERE name = 'parking_spots'";
+    db_ret_code = _run_sql_command(sql_statement, dbCallbackGetInt64, &last_spot_id);
+    if (db_ret_code != 0)
+    {
+        return GarageRetCode::ERR_DATABASE;
+    }
+    if (last_garage_id + 1 >= _config.idLimit || last_spot_id + numSpots >= _config.idLimit)
+    {
+        GARAGE_LOG(LOG_ERROR, "Cannot create garage: ids would reach the limit %d", _config.idLimit);
+        return GarageRetCode::ERR_IDS_EXHAUSTED;
+    }
+    return GarageRetCode::OK;
 }
 
 GarageRetCode GarageApi::_createSpot(int garageId, uint level, uint row, uint spot, SpotType spotType)
@@ -225,154 +531,213 @@ GarageRetCode GarageApi::_createSpot(int garageId, uint level, uint row, uint sp
     int db_ret_code = _run_sql_command(sql_statement);
     if (db_ret_code != 0)
     {
-        std::cout << "Error creating garage spot." << std::endl;
+        GARAGE_LOG(LOG_ERROR, "Error creating garage spot.");
         return GarageRetCode::ERR_DATABASE;
     }
     return GarageRetCode::OK;
 }
 
-int GarageApi::_getVacantSpotId(VehicleType vehicleType)
+GarageRetCode GarageApi::_getVacantSpotId(int garageId, const VehicleClass_t &vehicleClass, int &spotId)
 {
-    int spot_id = -1;
+    // Vacant compatible spots. Single spots go to the most preferred spot type
+    //  first, then by location. Runs are found in location order only, so a
+    //  run may mix any allowed spot types, as _dbParkVehicle accepts.
+    std::string spot_type_offset = "(spot_type - " + std::to_string(SpotType::SPOT_NONE) + ")";
     std::string sql_statement = ""
         "SELECT id, level, row, spot_num"
         " FROM parking_spots"
-        " WHERE parked_vehicle IS NULL";
-    // Get first ID that each vechicle can fit in
-    switch(vehicleType)
+        " WHERE"
+        " garage_id = " + std::to_string(garageId) +
+        " AND parked_vehicle IS NULL"
+        " AND ((" + std::to_string(vehicleClass.allowedSpotTypes) + " >> " + spot_type_offset + ") & 1)"
+        " ORDER BY ";
+    if (vehicleClass.footprint == 1U)
     {
-        case VehicleType::VEHICLE_MOTORCYCLE:
-            // Can park anywhere that's open, no need to filter
-            break;
-        case VehicleType::VEHICLE_CAR:
-            // Only large or compact spots, no motorcycle
-            sql_statement += ""
-                " AND spot_type in (" +
-                std::to_string(SpotType::SPOT_COMPACT) + "," +
-                std::to_string(SpotType::SPOT_LARGE) +
-                ")";
-            break;
-        case VehicleType::VEHICLE_BUS:
-            // Only large spots, no motorcycle or compact
-            sql_statement += ""
-                " AND spot_type = " + std::to_string(SpotType::SPOT_LARGE);
-            break;
-        default:
-            std::cout << "Invalid VehicleType: " << vehicleType << std::endl;
-            break;
+        sql_statement += ""
+            "((" + std::to_string(static_cast<int64_t>(SpotPreferenceRanks(vehicleClass))) + " >> (" + spot_type_offset + " * 4)) & 15) ASC,"
+            " level ASC, row ASC, spot_num ASC"
+            " LIMIT 1";
+    }
+    else
+    {
+        sql_statement += "level ASC, row ASC, spot_num ASC";
     }
-    sql_statement += ""
-        " ORDER BY level ASC, row ASC, spot_num ASC";
     std::vector<ParkingSpotInfo_t> vacant_spots{};
-    int db_ret_code =_run_sql_command(sql_statement, dbCallbackGetVacantParkingSpot, &vacant_spots);
+    int db_ret_code = _run_sql_command(sql_statement, dbCallbackGetVacantParkingSpot, &vacant_spots);
     if (db_ret_code != 0)
     {
         return GarageRetCode::ERR_DATABASE;
     }
 
-    if (!vacant_spots.empty())
+    // Find the first run of footprint consecutive spots (same level & row)
+    spotId = -1;
+    uint run_length = 0;
+    for (size_t i = 0; i < vacant_spots.size(); i++)
     {
-        switch(vehicleType)
+        const ParkingSpotInfo_t &spot = vacant_spots[i];
+        if (run_length > 0
+            && spot.level == vacant_spots[i - 1].level
+            && spot.row == vacant_spots[i - 1].row
+            && spot.spotNum == vacant_spots[i - 1].spotNum + 1)
         {
-            // No special handling, just grab the first spot
-            case VehicleType::VEHICLE_MOTORCYCLE:
-            case VehicleType::VEHICLE_CAR:
-                spot_id = vacant_spots[0].id;
-                break;
-            // Need to find 5 consecutive spots (same level & row)
-            case VehicleType::VEHICLE_BUS:
-                for (auto it = vacant_spots.begin(); it < vacant_spots.end() - 3;)
-                {
-                    bool spot_is_valid = false;
-                    uint cur_level = it->level;
-                    uint cur_row = it->row;
-                    uint cur_spot_num = it->spotNum;
-                    for (uint i = 1; i < 5; i++)
-                    {
-                        // If the row or level changes over the next 4 spots,
-                        //  move to the changed spot and start again.
-                        auto check_it = it + i;
-                        if ((check_it->level != cur_level)
-                            || (check_it->row != cur_row)
-                            || (check_it->spotNum != (cur_spot_num + i)))
-                        {
-                            it = check_it;
-                            spot_is_valid = false;
-                            break;
-                        }
-                        spot_is_valid = true;
-                    }
-                    // Should only be true if the previous loop doesn't break,
-                    //  meaning we have a valid bus spot.
-                    if (spot_is_valid)
-                    {
-                        spot_id = it->id;
-                        break;
-                    }
-                }
-                break;
-            default:
-                std::cout << "Invalid VehicleType: " << vehicleType << std::endl;
-                break;
+            run_length++;
+        }
+        else
+        {
+            run_length = 1;
+        }
+        if (run_length == vehicleClass.footprint)
+        {
+            spotId = vacant_spots[i + 1 - run_length].id;
+            break;
         }
     }
-
-    return spot_id;
+    return GarageRetCode::OK;
 }
 
-GarageRetCode GarageApi::_checkParkingSpotBus(ParkingSpotInfo_t parkingSpot)
+int GarageApi::_dbParkVehicle(int parkingSpotId, VehicleType vehicleType, int spotTypeMask, int footprint, int &changes)
 {
-    if (parkingSpot.spotType != SpotType::SPOT_LARGE)
+    // Vehicles taking more than one spot fill the anchor spot and the spots
+    //  after it in the same row, all in one guarded multi-row update
+    sqlite3_stmt **stmt = (footprint == 1) ? &_parkStmt : &_parkMultiStmt;
+    if (*stmt == nullptr)
     {
-        return GarageRetCode::ERR_INVALID_SPOT;
+        std::string spot_type_check = " AND ((?3 >> (s.spot_type - " + std::to_string(SpotType::SPOT_NONE) + ")) & 1)";
+        std::string sql_statement;
+        if (footprint == 1)
+        {
+            sql_statement = ""
+                "UPDATE parking_spots AS s"
+                " SET parked_vehicle = ?1"
+                " WHERE"
+                " s.id = ?2"
+                " AND s.parked_vehicle IS NULL" +
+                spot_type_check;
+        }
+        else
+        {
+            std::string footprint_spots = ""
+                " FROM parking_spots AS a"
+                " JOIN parking_spots AS s"
+                " ON s.garage_id = a.garage_id"
+                " AND s.level = a.level"
+                " AND s.row = a.row"
+                " AND s.spot_num BETWEEN a.spot_num AND a.spot_num + ?4 - 1"
+                " WHERE a.id = ?2";
+            sql_statement = ""
+                "UPDATE parking_spots"
+                " SET parked_vehicle = ?1"
+                " WHERE"
+                " id IN (SELECT s.id" + footprint_spots + ")"
+                " AND (SELECT COUNT(*)" + footprint_spots +
+                " AND s.parked_vehicle IS NULL" + spot_type_check + ") = ?4";
+        }
+        int db_ret_code = _prepare_sql_statement(sql_statement, stmt);
+        if (db_ret_code != SQLITE_OK)
+        {
+            return db_ret_code;
+        }
+    }
+    sqlite3_bind_int(*stmt, 1, vehicleType);
+    sqlite3_bind_int(*stmt, 2, parkingSpotId);
+    sqlite3_bind_int(*stmt, 3, spotTypeMask);
+    if (footprint != 1)
+    {
+        sqlite3_bind_int(*stmt, 4, footprint);
     }
+    int db_ret_code = _run_sql_statement(*stmt);
+    changes = (db_ret_code == SQLITE_OK) ? sqlite3_changes(_db) : 0;
+    return db_ret_code;
+}
 
-    // Get all spots in same garage, same level, same row, same size, 
-    std::string sql_statement = ""
-        "SELECT id"
-        " FROM parking_spots"
-        " WHERE"
-        " level = " + std::to_string(parkingSpot.level) +
-        " AND row = " + std::to_string(parkingSpot.row) +
-        " AND spot_num BETWEEN " + std::to_string(parkingSpot.spotNum) + " AND " + std::to_string(parkingSpot.spotNum + 4);
-    std::vector<int> spots{};
-    int db_ret_code = _run_sql_command(sql_statement, dbCallbackCheckParkingSpotBus, &spots);
-    if (db_ret_code != 0)
+GarageRetCode GarageApi::_getFootprintSpots(int parkingSpotId, int footprint, std::vector<ParkingSpotInfo_t> &spots)
+{
+    if (_footprintStmt == nullptr)
     {
-        return GarageRetCode::ERR_DATABASE;
+        std::string sql_statement = ""
+            "SELECT s.*"
+            " FROM parking_spots AS a"
+            " JOIN parking_spots AS s"
+            " ON s.garage_id = a.garage_id"
+            " AND s.level = a.level"
+            " AND s.row = a.row"
+            " AND s.spot_num BETWEEN a.spot_num AND a.spot_num + ?2 - 1"
+            " WHERE a.id = ?1";
+        if (_prepare_sql_statement(sql_statement, &_footprintStmt) != SQLITE_OK)
+        {
+            return GarageRetCode::ERR_DATABASE;
+        }
     }
-    else if (spots.size() != 5)
+    sqlite3_bind_int(_footprintStmt, 1, parkingSpotId);
+    sqlite3_bind_int(_footprintStmt, 2, footprint);
+    int db_ret_code;
+    while ((db_ret_code = sqlite3_step(_footprintStmt)) == SQLITE_ROW)
     {
-        return GarageRetCode::ERR_INVALID_SPOT;
+        ParkingSpotInfo_t parking_spot;
+        dbStatementGetParkingSpotInfo(_footprintStmt, parking_spot);
+        spots.push_back(parking_spot);
+    }
+    sqlite3_reset(_footprintStmt);
+    if (db_ret_code != SQLITE_DONE)
+    {
+        GARAGE_LOG(LOG_ERROR, "Failure reading spots of %d: %s", parkingSpotId, sqlite3_errmsg(_db));
+        spots.clear();
+        return GarageRetCode::ERR_DATABASE;
     }
     return GarageRetCode::OK;
 }
 
-GarageRetCode GarageApi::_dbUpdateParkingSpot(int parkingSpotId, VehicleType vehicleType)
+void GarageApi::_recordPark(int parkingSpotId, int footprint)
 {
-    // ASSUMPTION: This function assumes the spot if valid, and in the case of
-    // buses, that the next 4 consecutive row_id spots are also the next 4
-    // consecutive spot_nums. (Garage generation ensures this for now)
-    std::string sql_statement = ""
-        "UPDATE parking_spots"
-        " SET parked_vehicle = " + std::to_string(vehicleType);
-    switch(vehicleType)
-    {
-        case VehicleType::VEHICLE_MOTORCYCLE:
-        case VehicleType::VEHICLE_CAR:
-            sql_statement += ""
-                " WHERE id = " + std::to_string(parkingSpotId);
-            break;
-        case VehicleType::VEHICLE_BUS:
-            sql_statement += ""
-                " WHERE id BETWEEN " + std::to_string(parkingSpotId) + " AND " + std::to_string(parkingSpotId + 4);
-            break;
-        default:
-            break;
+    // One read of the parked spots for their level and type. UPDATE ...
+    //  RETURNING was measured to cost as much as this SELECT, and would slow
+    //  every park whether or not anything is recording.
+    std::vector<ParkingSpotInfo_t> parked_spots{};
+    if (_getFootprintSpots(parkingSpotId, footprint, parked_spots) != GarageRetCode::OK || parked_spots.empty())
+    {
+        return;
+    }
+    // The first park seen in a garage (e.g. after a restart) counts every
+    //  filled spot, these included
+    int garage_id = parked_spots.front().garageId;
+    bool on_board = (_board != nullptr) && (_unpublishedGarages.count(garage_id) == 0);
+    if ((_recorder != nullptr && !_recorder->HasGarage(garage_id))
+        || (on_board && !_board->HasGarage(garage_id)))
+    {
+        _publishGarageOccupancy(garage_id);
+        return;
+    }
+    // Spots of a run may differ in type, so each is counted on its own
+    for (const ParkingSpotInfo_t &parking_spot : parked_spots)
+    {
+        if (_recorder != nullptr)
+        {
+            _recorder->Adjust(garage_id, parking_spot.level, parking_spot.spotType, 1);
+        }
+        if (on_board)
+        {
+            _board->AdjustVacant(garage_id, parking_spot.level, parking_spot.spotType, -1);
+        }
+    }
+}
+
+GarageRetCode GarageApi::Commit()
+{
+    if (!_batchOpen)
+    {
+        return GarageRetCode::OK;
+    }
+    _batchOpen = false;
+    _batchedWrites = 0;
+    int db_ret_code = _end_transaction();
+    if (db_ret_code == SQLITE_ABORT)
+    {
+        GARAGE_LOG(LOG_ERROR, "Batch rolled back after a failed write");
+        return GarageRetCode::ERR_DATABASE;
     }
-    int db_ret_code = _run_sql_command(sql_statement);
     if (db_ret_code != 0)
     {
+        GARAGE_LOG(LOG_ERROR, "Failure committing batch: %s", sqlite3_errmsg(_db));
         return GarageRetCode::ERR_DATABASE;
     }
     return GarageRetCode::OK;
@@ -380,14 +745,60 @@ GarageRetCode GarageApi::_dbUpdateParkingSpot(int parkingSpotId, VehicleType veh
 
 int GarageApi::_run_sql_command(std::string sql_statement)
 {
+    // Writes are grouped into an outer transaction that commits every
+    //  commitBatchSize writes, see Commit()
+    if (_config.commitBatchSize > 1U && !_batchOpen)
+    {
+        _start_transaction();
+        _batchOpen = true;
+    }
+    // SQLite undoes a failed statement on its own, so the enclosing
+    //  transaction is left for the caller to commit or roll back
     _start_transaction();
     int db_ret_code = sqlite3_exec(_db, sql_statement.c_str(), NULL, NULL, NULL);
     if (db_ret_code != 0)
     {
-        std::cout << "Failure running sqlite3 command: " << sql_statement << std::endl;
-        _rollback_transaction();
+        GARAGE_LOG(LOG_ERROR, "Failure running sqlite3 command: %s", sql_statement.c_str());
     }
     _end_transaction();
+    if (_batchOpen && ++_batchedWrites >= _config.commitBatchSize)
+    {
+        Commit();
+    }
+    return db_ret_code;
+}
+
+int GarageApi::_run_sql_statement(sqlite3_stmt *stmt)
+{
+    // A single statement is atomic on its own, so it only joins a transaction
+    //  when writes are being batched
+    if (_config.commitBatchSize > 1U && !_batchOpen)
+    {
+        _start_transaction();
+        _batchOpen = true;
+    }
+    int db_ret_code = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (db_ret_code != SQLITE_DONE)
+    {
+        GARAGE_LOG(LOG_ERROR, "Failure running sqlite3 statement: %s", sqlite3_errmsg(_db));
+        return db_ret_code;
+    }
+    if (_batchOpen && ++_batchedWrites >= _config.commitBatchSize)
+    {
+        Commit();
+    }
+    return SQLITE_OK;
+}
+
+int GarageApi::_prepare_sql_statement(const std::string &sql_statement, sqlite3_stmt **stmt)
+{
+    int db_ret_code = sqlite3_prepare_v2(_db, sql_statement.c_str(), -1, stmt, NULL);
+    if (db_ret_code != SQLITE_OK)
+    {
+        GARAGE_LOG(LOG_ERROR, "Failure preparing sqlite3 statement: %s", sql_statement.c_str());
+        *stmt = nullptr;
+    }
     return db_ret_code;
 }
 
@@ -397,8 +808,7 @@ int GarageApi::_run_sql_command(std::string sql_statement, int (*callback)(void*
     int db_ret_code = sqlite3_exec(_db, sql_statement.c_str(), callback, passed, NULL);
     if (db_ret_code != 0)
     {
-        std::cout << "Failure running sqlite3 command: " << sql_statement << std::endl;
-        _rollback_transaction();
+        GARAGE_LOG(LOG_ERROR, "Failure running sqlite3 command: %s", sql_statement.c_str());
     }
     _end_transaction();
     return db_ret_code;
@@ -406,25 +816,60 @@ int GarageApi::_run_sql_command(std::string sql_statement, int (*callback)(void*
 
 int GarageApi::_start_transaction()
 {
+    if (_transactionDepth++ > 0)
+    {
+        return SQLITE_OK;
+    }
+    _transactionRolledBack = false;
     return sqlite3_exec(_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
 }
 
 int GarageApi::_rollback_transaction()
 {
+    // Rolls back the outermost transaction from any level, so an open batch
+    //  is lost with it. Levels still open run in autocommit until it ends.
+    if (_transactionDepth == 0 || _transactionRolledBack)
+    {
+        return SQLITE_OK;
+    }
+    _transactionRolledBack = true;
     return sqlite3_exec(_db, "ROLLBACK;", NULL, NULL, NULL);
 }
 
 int GarageApi::_end_transaction()
 {
+    if (_transactionDepth == 0 || --_transactionDepth > 0)
+    {
+        return SQLITE_OK;
+    }
+    if (_transactionRolledBack)
+    {
+        return SQLITE_ABORT;
+    }
     return sqlite3_exec(_db, "END TRANSACTION;", NULL, NULL, NULL);
 }
 
+void GarageApi::_applyConfig()
+{
+    // Pragmas that change the journal or foreign key enforcement are ignored
+    //  inside a transaction, so these run outside of _run_sql_command
+    std::string sql_statement = ""
+        "PRAGMA foreign_keys=ON;"
+        "PRAGMA journal_mode=" + _config.journalMode + ";"
+        "PRAGMA synchronous=" + _config.synchronous + ";"
+        "PRAGMA cache_size=-" + std::to_string(_config.cacheSizeKb) + ";"
+        "PRAGMA mmap_size=" + std::to_string(_config.mmapSize) + ";"
+        "PRAGMA temp_store=" + (_config.tempStoreMemory ? "MEMORY" : "DEFAULT") + ";";
+    int db_ret_code = sqlite3_exec(_db, sql_statement.c_str(), NULL, NULL, NULL);
+    if (db_ret_code != 0)
+    {
+        GARAGE_LOG(LOG_ERROR, "Failure applying database config: %s", sqlite3_errmsg(_db));
+    }
+}
+
 void GarageApi::_createDbTables()
 {
     std::string sql_statement;
-    sql_statement = ""
-        "PRAGMA foreign_keys=ON;";
-    _run_sql_command(sql_statement);
     sql_statement = ""
         "CREATE TABLE IF NOT EXISTS garages("
         " id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,"
@@ -446,10 +891,41 @@ void GarageApi::_createDbTables()
         " CONSTRAINT unq UNIQUE (garage_id, level, row, spot_num)"
         ")";
     _run_sql_command(sql_statement);
+    // Lets GetSpotPage seek to (garage_id, id) and read pages in id order
+    //  without sorting the garage
+    sql_statement = ""
+        "CREATE INDEX IF NOT EXISTS parking_spots_garage_id"
+        " ON parking_spots(garage_id, id)";
+    _run_sql_command(sql_statement);
+    if (_config.idBase > 0)
+    {
+        // Start both id sequences at idBase, unless ids were already handed out
+        sql_statement = ""
+            "INSERT INTO sqlite_sequence(name, seq)"
+            " SELECT name, " + std::to_string(_config.idBase) +
+            " FROM (SELECT 'garages' AS name UNION ALL SELECT 'parking_spots')"
+            " WHERE name NOT IN (SELECT name FROM sqlite_sequence)";
+        _run_sql_command(sql_statement);
+    }
+}
+
+void GarageApi::_finalizeStatements()
+{
+    sqlite3_finalize(_spotPageStmt);
+    _spotPageStmt = nullptr;
+    sqlite3_finalize(_spotInfoStmt);
+    _spotInfoStmt = nullptr;
+    sqlite3_finalize(_parkStmt);
+    _parkStmt = nullptr;
+    sqlite3_finalize(_parkMultiStmt);
+    _parkMultiStmt = nullptr;
+    sqlite3_finalize(_footprintStmt);
+    _footprintStmt = nullptr;
 }
 
 void GarageApi::_dropDbTables()
 {
+    _finalizeStatements();
     std::string sql_statement;
     sql_statement = "DROP TABLE IF EXISTS garages";
     _run_sql_command(sql_statement);
@@ -459,6 +935,36 @@ void GarageApi::_dropDbTables()
 
 void GarageApi::Reset()
 {
+    Commit();
     _dropDbTables();
     _createDbTables();
-}
\ No newline at end of file
+    if (_recorder != nullptr)
+    {
+        _recorder->Clear();
+    }
+    if (_board != nullptr)
+    {
+        _board->Clear();
+    }
+    _unpublishedGarages.clear();
+}
+
+SpotCursor::SpotCursor(GarageApi *api, int garageId, SpotFilter_t filter, uint pageSize, int token):
+    _api(api),
+    _garageId(garageId),
+    _filter(filter),
+    _pageSize(pageSize),
+    _token(token)
+{
+}
+
+GarageRetCode SpotCursor::Next(std::vector<ParkingSpotInfo_t> &page)
+{
+    int next_token = _token;
+    GarageRetCode ret_code = _api->GetSpotPage(_garageId, _filter, _token, _pageSize, page, next_token);
+    if (ret_code == GarageRetCode::OK)
+    {
+        _token = next_token;
+    }
+    return ret_code;
+}
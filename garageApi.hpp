@@ -5,8 +5,16 @@
  */
 #pragma once
 
+#include "spotBitmap.hpp"
+
 #include <sqlite3.h>
+#include <sys/types.h>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 
@@ -20,6 +28,9 @@ enum GarageRetCode {
     ERR_INVALID_VEHICLE_TYPE,
     ERR_NO_VACANT_SPOT,
     ERR_SPOT_FULL,
+    ERR_SHARED_MEMORY,
+    ERR_BUSY,
+    ERR_IDS_EXHAUSTED,
 };
 
 enum SpotType {
@@ -36,13 +47,26 @@ enum VehicleType {
     VEHICLE_BUS,
 };
 
+enum DurabilityProfile {
+    PROFILE_STRICT = 500,
+    PROFILE_BALANCED,
+    PROFILE_EPHEMERAL,
+    PROFILE_BULK_LOAD,
+};
+
+enum SpotOccupancy {
+    OCCUPANCY_ANY = 300,
+    OCCUPANCY_VACANT,
+    OCCUPANCY_FILLED,
+};
+
 typedef struct GarageInfo_t {
     int id              = -1;
     int levels          = 0;
     uint rowsPerLevel   = 0;
     uint spotsPerRow    = 0;
-    std::vector<int> spotsFilled{};
-    std::vector<int> spotsVacant{};
+    SpotBitmap spotsFilled{};
+    SpotBitmap spotsVacant{};
 } GarageInfo_t;
 
 inline std::ostream &operator<<(std::ostream &os, const GarageInfo_t &value)
@@ -69,6 +93,107 @@ typedef struct VehicleInfo_t {
     VehicleType vehicleType = VEHICLE_NONE;
 } VehicleInfo_t;
 
+typedef struct SpotFilter_t {
+    int level               = -1;   // -1 matches every level
+    SpotType spotType       = SPOT_NONE;    // SPOT_NONE matches every type
+    SpotOccupancy occupancy = OCCUPANCY_ANY;
+} SpotFilter_t;
+
+typedef struct GarageConfig_t {
+    DurabilityProfile profile   = PROFILE_STRICT;
+    std::string journalMode     = "DELETE";
+    std::string synchronous     = "FULL";
+    int  cacheSizeKb            = 2000;     // PRAGMA cache_size = -cacheSizeKb
+    long mmapSize               = 0;        // Bytes, 0 disables memory mapped I/O
+    bool tempStoreMemory        = false;
+    bool inMemory               = false;    // OpenGarageDb ignores the path and opens ":memory:"
+    uint commitBatchSize        = 1;        // Writes grouped into each commit
+    int  idBase                 = 0;        // Garage and spot ids start after this
+    int  idLimit                = 0;        // CreateGarage never hands out ids at or above this; 0 for no limit
+} GarageConfig_t;
+
+/**
+ * Get the settings of a named durability profile.
+ *
+ *  STRICT:     Rollback journal, fsync on every commit. Nothing committed is lost.
+ *  BALANCED:   WAL, synchronous=NORMAL. Survives crashes, may lose the last
+ *               commits on power loss.
+ *  EPHEMERAL:  In-memory database. Nothing survives the process.
+ *  BULK_LOAD:  In-memory journal, no fsync, commits every 1000 writes. A crash
+ *               loses the open batch and may corrupt the database.
+ *
+ * @param profile Requested profile.
+ * @return profile settings.
+ */
+GarageConfig_t GarageConfigForProfile(DurabilityProfile profile);
+/**
+ * Get the settings of a durability profile by name: "strict", "balanced",
+ *  "ephemeral" or "bulk-load".
+ *
+ * @param name Profile name.
+ * @param config (OUT) Profile settings.
+ * @return relevant return code.
+ */
+GarageRetCode GarageConfigFromName(const std::string &name, GarageConfig_t &config);
+/**
+ * Open a database suitable for a config. In-memory profiles ignore the path.
+ *
+ * @param path Database file path.
+ * @param config Settings the database will be used with.
+ * @param db (OUT) Opened database, to be closed with sqlite3_close.
+ * @return relevant return code.
+ */
+GarageRetCode OpenGarageDb(const std::string &path, const GarageConfig_t &config, sqlite3 **db);
+
+// Continuation token of a spot iteration that has not started yet
+const int SPOT_CURSOR_START = 0;
+// Continuation token of a spot iteration that has visited every spot
+const int SPOT_CURSOR_DONE = -1;
+
+class GarageApi;
+class OccupancyBoard;
+class OccupancyRecorder;
+struct VehicleClass_t;
+
+class SpotCursor
+{
+public:
+    /**
+     * Create a cursor over the parking spots of a garage, in ascending id order.
+     * 
+     * @param api API used to read the parking spots.
+     * @param garageId ID of the requested parking garage.
+     * @param filter Only spots matching this filter are returned.
+     * @param pageSize Maximum number of spots returned by each call to Next.
+     * @param token Continuation token to resume from, see Token().
+     */
+    SpotCursor(GarageApi *api, int garageId, SpotFilter_t filter = {}, uint pageSize = 256, int token = SPOT_CURSOR_START);
+
+    /**
+     * Fetch the next page of parking spots. The page is empty once the
+     *  cursor is done.
+     * 
+     * @param page (OUT) Cleared and populated with the next page of spots.
+     * @return relevant return code.
+     */
+    GarageRetCode Next(std::vector<ParkingSpotInfo_t> &page);
+    /**
+     * @return true once every matching spot has been returned.
+     */
+    bool Done() const { return _token == SPOT_CURSOR_DONE; }
+    /**
+     * @return token that resumes iteration after the last returned page.
+     */
+    int Token() const { return _token; }
+
+private:
+    GarageApi *_api;
+    int _garageId;
+    SpotFilter_t _filter;
+    uint _pageSize;
+    int _token;
+};
+
 class GarageApi
 {
 public:
@@ -76,10 +201,11 @@ public:
      * Create an API for parking garage manipulation.
      * 
      * @param db A reference to and already open sqlite3 database.
+     * @param config Durability settings applied to the database.
      * @return API object.
      */
-    GarageApi(sqlite3 *db);
-    ~GarageApi(){};
+    GarageApi(sqlite3 *db, GarageConfig_t config = GarageConfigForProfile(PROFILE_STRICT));
+    ~GarageApi();
 
     /**
      * Create a new garage entry and accompanying parking spot entries
@@ -111,8 +237,45 @@ public:
      */
     GarageRetCode GetParkingSpotInfo(int parkingSpotId, ParkingSpotInfo_t &parkingSpotInfo);
     /**
-     * Attempt to park a vehicle in the requested parking garage. The first compatible
-     *  and empty spot will be chosen. Will return an error if no spots can be found.
+     * Populate a bitmap with the ids of every parking spot in a garage that
+     *  matches the requested level and spot type. Intersect the result with
+     *  GarageInfo_t::spotsVacant to e.g. find vacant large spots on level 2.
+     * 
+     * @param garageId ID of the requested parking garage.
+     * @param level Zero-based level to match, or -1 for every level.
+     * @param spotType Spot type to match, or SPOT_NONE for every type.
+     * @param spots (OUT) Bitmap populated with the matching parking spot ids.
+     * @return relevant return code.
+     */
+    GarageRetCode GetGarageSpots(int garageId, int level, SpotType spotType, SpotBitmap &spots);
+    /**
+     * Populate a page of parking spots of a garage, in ascending id order,
+     *  starting after the spot identified by a continuation token.
+     * 
+     * @param garageId ID of the requested parking garage.
+     * @param filter Only spots matching this filter are returned.
+     * @param token SPOT_CURSOR_START or a token returned by a previous call.
+     * @param pageSize Maximum number of spots to return.
+     * @param page (OUT) Cleared and populated with the requested spots.
+     * @param nextToken (OUT) Token for the next page, SPOT_CURSOR_DONE when there is none.
+     * @return relevant return code.
+     */
+    GarageRetCode GetSpotPage(int garageId, SpotFilter_t filter, int token, uint pageSize, std::vector<ParkingSpotInfo_t> &page, int &nextToken);
+    /**
+     * Call a function for every parking spot of a garage matching a filter,
+     *  in ascending id order. Spots are read a page at a time, so memory
+     *  stays bounded for any garage size.
+     * 
+     * @param garageId ID of the requested parking garage.
+     * @param filter Only spots matching this filter are visited.
+     * @param callback Called once per spot. Return false to stop iterating.
+     * @return relevant return code.
+     */
+    GarageRetCode ForEachSpot(int garageId, SpotFilter_t filter, std::function<bool(const ParkingSpotInfo_t&)> callback);
+    /**
+     * Attempt to park a vehicle in the requested parking garage. The first empty
+     *  spot of the vehicle's most preferred spot type will be chosen, see
+     *  VEHICLE_CLASSES. Will return an error if no spots can be found.
      * 
      * @param vehicle Vehicle to park.
      * @param garageId ID of the requested parking garage.
@@ -129,6 +292,34 @@ public:
      * @return relevant return code.
      */
     GarageRetCode ParkVehicleInSpot(VehicleInfo_t vehicle, int parkingSpotId);
+    /**
+     * Commit any writes held back by GarageConfig_t::commitBatchSize.
+     * 
+     * A CreateGarage that fails partway rolls back the whole batch, and
+     *  Commit then returns ERR_DATABASE.
+     * 
+     * @return relevant return code.
+     */
+    GarageRetCode Commit();
+    /**
+     * @return the settings this API was created with.
+     */
+    const GarageConfig_t &GetConfig() const { return _config; }
+    /**
+     * Record occupancy changes from CreateGarage and parking into the
+     *  recorder. The recorder is not owned and must outlive this API.
+     * 
+     * @param recorder Recorder to update, or nullptr to stop recording.
+     */
+    void SetOccupancyRecorder(OccupancyRecorder *recorder) { _recorder = recorder; }
+    /**
+     * Publish live vacancy counts from CreateGarage and parking to a shared
+     *  memory board. The board is not owned and must outlive this API; Reset
+     *  clears it, so only one GarageApi should write to a board.
+     * 
+     * @param board Writable board from OccupancyBoard::Create, or nullptr to stop publishing.
+     */
+    void SetOccupancyBoard(OccupancyBoard *board) { _board = board; _unpublishedGarages.clear(); }
     /**
      * Drops and re-creates the garages and parking_spots tables of the database.
      * 
@@ -137,17 +328,42 @@ public:
     void Reset();
 
 private:
+    void    _applyConfig();
     void    _createDbTables();
     void    _dropDbTables();
     int     _run_sql_command(std::string sql_statement);
     int     _run_sql_command(std::string sql_statement, int (*callback)(void*, int, char**, char**), void *passed);
+    int     _run_sql_statement(sqlite3_stmt *stmt);
+    int     _prepare_sql_statement(const std::string &sql_statement, sqlite3_stmt **stmt);
     int     _start_transaction();
     int     _rollback_transaction();
     int     _end_transaction();
-    int     _getVacantSpotId(VehicleType vehicleType);
+    GarageRetCode _getVacantSpotId(int garageId, const VehicleClass_t &vehicleClass, int &spotId);
     GarageRetCode _createSpot(int garageId, uint level, uint row, uint spotNum, SpotType spotType);
-    GarageRetCode _checkParkingSpotBus(ParkingSpotInfo_t parkingSpot);
-    GarageRetCode _dbUpdateParkingSpot(int parkingSpotId, VehicleType vehicleType);
+    int     _dbParkVehicle(int parkingSpotId, VehicleType vehicleType, int spotTypeMask, int footprint, int &changes);
+    GarageRetCode _getFootprintSpots(int parkingSpotId, int footprint, std::vector<ParkingSpotInfo_t> &spots);
+    void    _recordPark(int parkingSpotId, int footprint);
+    void    _finalizeStatements();
+    GarageRetCode _publishGarageOccupancy(int garageId);
+    GarageRetCode _checkIdLimit(int64_t numSpots);
 
     sqlite3 *_db;
+    GarageConfig_t _config;
+    sqlite3_stmt *_spotPageStmt = nullptr;
+    sqlite3_stmt *_spotInfoStmt = nullptr;
+    sqlite3_stmt *_parkStmt = nullptr;
+    sqlite3_stmt *_parkMultiStmt = nullptr;
+    sqlite3_stmt *_footprintStmt = nullptr;
+    // Nesting depth of _start_transaction; only the outermost level reaches SQLite
+    int  _transactionDepth = 0;
+    bool _transactionRolledBack = false;
+    // Outer transaction grouping writes when commitBatchSize > 1
+    bool _batchOpen = false;
+    uint _batchedWrites = 0;
+    OccupancyRecorder *_recorder = nullptr;
+    OccupancyBoard *_board = nullptr;
+    // Garages the board had no slot for; parks in them skip the board
+    std::unordered_set<int> _unpublishedGarages{};
+    // Picks row spot types; owned per API so shards never share rand()'s state
+    std::minstd_rand _spotTypeRng{};
 };
\ No newline at end of file
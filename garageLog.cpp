@@ -0,0 +1,241 @@
+#include "garageLog.hpp"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <unordered_map>
+
+
+static int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static const char *levelName(LogLevel level)
+{
+    switch (level)
+    {
+        case LogLevel::LOG_DEBUG:   return "DEBUG";
+        case LogLevel::LOG_INFO:    return "INFO";
+        case LogLevel::LOG_WARN:    return "WARN";
+        case LogLevel::LOG_ERROR:   return "ERROR";
+        default:                    return "?";
+    }
+}
+
+typedef struct RateState_t {
+    int64_t  windowStartNs  = 0;
+    uint     count          = 0;
+    uint64_t suppressed     = 0;
+} RateState_t;
+
+// Per-thread producer state. Retires the ring when the thread exits so the
+//  drain thread can free it once it is empty.
+struct LogThreadState {
+    GarageLogger::LogRing_t *ring = nullptr;
+    std::unordered_map<const char*, RateState_t> sites{};
+
+    ~LogThreadState()
+    {
+        if (ring != nullptr)
+        {
+            GarageLogger::Instance()._retireRing(ring);
+        }
+    }
+};
+
+static thread_local LogThreadState threadState;
+
+
+GarageLogger &GarageLogger::Instance()
+{
+    static GarageLogger logger;
+    return logger;
+}
+
+GarageLogger::GarageLogger()
+{
+    _drainThread = std::thread(&GarageLogger::_drainLoop, this);
+}
+
+GarageLogger::~GarageLogger()
+{
+    _stop.store(true);
+    _wake.notify_one();
+    if (_drainThread.joinable())
+    {
+        _drainThread.join();
+    }
+    _drain();
+}
+
+void GarageLogger::Log(LogLevel level, const char *format, ...)
+{
+    if (level < _level.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    int64_t now = nowNs();
+
+    // Rate limit per call site
+    RateState_t &site = threadState.sites[format];
+    if (now - site.windowStartNs >= RATE_LIMIT_WINDOW_NS)
+    {
+        site.windowStartNs = now;
+        site.count = 0;
+    }
+    if (site.count >= RATE_LIMIT_COUNT)
+    {
+        site.suppressed++;
+        _suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    site.count++;
+
+    LogRing_t *ring = _threadRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= RING_CAPACITY)
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LogRecord_t &record = ring->records[head & (RING_CAPACITY - 1)];
+    record.timestampNs = now;
+    record.level = level;
+    record.threadIndex = ring->threadIndex;
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(record.message, MESSAGE_SIZE, format, args);
+    va_end(args);
+    if (site.suppressed > 0 && length >= 0 && static_cast<size_t>(length) < MESSAGE_SIZE)
+    {
+        snprintf(record.message + length, MESSAGE_SIZE - length,
+            " (%lu similar messages suppressed)", static_cast<unsigned long>(site.suppressed));
+        site.suppressed = 0;
+    }
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void GarageLogger::Flush()
+{
+    _drain();
+}
+
+void GarageLogger::SetSink(std::ostream *sink)
+{
+    std::lock_guard<std::mutex> lock(_drainMutex);
+    _sink = sink;
+}
+
+void *GarageLogger::LogRing_t::operator new(size_t size)
+{
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignof(LogRing_t), size) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void GarageLogger::LogRing_t::operator delete(void *ptr)
+{
+    free(ptr);
+}
+
+GarageLogger::LogRing_t *GarageLogger::_threadRing()
+{
+    if (threadState.ring == nullptr)
+    {
+        std::unique_ptr<LogRing_t> ring(new LogRing_t());
+        std::lock_guard<std::mutex> lock(_ringsMutex);
+        ring->threadIndex = _nextThreadIndex++;
+        threadState.ring = ring.get();
+        _rings.push_back(std::move(ring));
+    }
+    return threadState.ring;
+}
+
+void GarageLogger::_retireRing(LogRing_t *ring)
+{
+    ring->retired.store(true, std::memory_order_release);
+}
+
+bool GarageLogger::_drain()
+{
+    std::lock_guard<std::mutex> drain_lock(_drainMutex);
+    // A thread's first message takes _ringsMutex, so it is only held to copy
+    //  the ring list and to free retired rings, never around sink I/O. Rings
+    //  are only freed here, so the copied pointers stay valid.
+    {
+        std::lock_guard<std::mutex> rings_lock(_ringsMutex);
+        _drainRings.clear();
+        for (const std::unique_ptr<LogRing_t> &ring : _rings)
+        {
+            _drainRings.push_back(ring.get());
+        }
+    }
+    bool wrote = false;
+    bool any_retired = false;
+    for (LogRing_t *ring : _drainRings)
+    {
+        // Read retired first so a ring is only freed after its final records are drained
+        any_retired = any_retired || ring->retired.load(std::memory_order_acquire);
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail < head; tail++)
+        {
+            const LogRecord_t &record = ring->records[tail & (RING_CAPACITY - 1)];
+            time_t seconds = record.timestampNs / 1000000000;
+            struct tm tm_utc;
+            gmtime_r(&seconds, &tm_utc);
+            char timestamp[32];
+            size_t length = strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm_utc);
+            snprintf(timestamp + length, sizeof(timestamp) - length, ".%06ldZ",
+                static_cast<long>((record.timestampNs % 1000000000) / 1000));
+            *_sink << timestamp << " " << levelName(record.level) << " [" << record.threadIndex << "] "
+                << record.message << '\n';
+            wrote = true;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    if (wrote)
+    {
+        _sink->flush();
+    }
+    if (any_retired)
+    {
+        std::lock_guard<std::mutex> rings_lock(_ringsMutex);
+        for (auto it = _rings.begin(); it != _rings.end();)
+        {
+            LogRing_t *ring = it->get();
+            // Retired rings get no new records, so an empty one is done
+            if (ring->retired.load(std::memory_order_acquire)
+                && ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire))
+            {
+                it = _rings.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+    return wrote;
+}
+
+void GarageLogger::_drainLoop()
+{
+    while (!_stop.load())
+    {
+        if (!_drain())
+        {
+            // Producers never signal, so poll at a low rate when idle
+            std::unique_lock<std::mutex> lock(_wakeMutex);
+            _wake.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+}
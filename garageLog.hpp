@@ -0,0 +1,123 @@
+/*
+ * Garage logging definitions.
+ *
+ * Diagnostics are formatted on the calling thread into a per-thread ring
+ *  buffer and written out by a background drain thread, so logging never
+ *  blocks on console I/O. Repeated messages from the same call site are
+ *  rate limited, and messages are dropped (and counted) if a ring is full.
+ */
+#pragma once
+
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+enum LogLevel {
+    LOG_DEBUG = 400,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR,
+    LOG_NONE,
+};
+
+class GarageLogger
+{
+public:
+    static const size_t RING_CAPACITY       = 256;  // Records per thread, power of 2
+    static const size_t MESSAGE_SIZE        = 232;  // Bytes per record, including terminator
+    static const uint   RATE_LIMIT_COUNT    = 5;    // Messages per call site per window
+    static const int64_t RATE_LIMIT_WINDOW_NS = 1000000000;
+
+    /**
+     * @return the process wide logger. The drain thread starts on first use.
+     */
+    static GarageLogger &Instance();
+
+    /**
+     * Format and queue a message. Never blocks.
+     *
+     * @param level Severity of the message. Ignored if below the current level.
+     * @param format printf style format string. Also identifies the call
+     *  site for rate limiting, so pass a string literal.
+     */
+    void Log(LogLevel level, const char *format, ...) __attribute__((format(printf, 3, 4)));
+    /**
+     * Write out every queued message before returning.
+     */
+    void Flush();
+    /**
+     * Set the minimum level of messages to queue. Defaults to LOG_INFO.
+     */
+    void SetLevel(LogLevel level) { _level.store(level, std::memory_order_relaxed); }
+    LogLevel GetLevel() const { return _level.load(std::memory_order_relaxed); }
+    /**
+     * Redirect output. The stream must outlive the logger or the next SetSink.
+     */
+    void SetSink(std::ostream *sink);
+    /**
+     * @return number of messages dropped because a ring was full.
+     */
+    uint64_t DroppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+    /**
+     * @return number of messages suppressed by rate limiting.
+     */
+    uint64_t SuppressedCount() const { return _suppressed.load(std::memory_order_relaxed); }
+
+    ~GarageLogger();
+
+private:
+    typedef struct LogRecord_t {
+        int64_t  timestampNs    = 0;
+        LogLevel level          = LOG_INFO;
+        uint32_t threadIndex    = 0;
+        char     message[MESSAGE_SIZE];
+    } LogRecord_t;
+
+    // Single producer (the owning thread), single consumer (whoever holds _drainMutex)
+    typedef struct LogRing_t {
+        alignas(64) std::atomic<uint64_t> head{0};  // Next slot to write
+        alignas(64) std::atomic<uint64_t> tail{0};  // Next slot to read
+        alignas(64) std::atomic<bool> retired{false};
+        uint32_t threadIndex = 0;
+        LogRecord_t records[RING_CAPACITY];
+
+        // Plain new only honours the alignment above from C++17
+        static void *operator new(size_t size);
+        static void operator delete(void *ptr);
+    } LogRing_t;
+
+    GarageLogger();
+    LogRing_t *_threadRing();
+    void    _retireRing(LogRing_t *ring);
+    bool    _drain();
+    void    _drainLoop();
+
+    friend struct LogThreadState;
+
+    std::atomic<LogLevel> _level{LOG_INFO};
+    std::atomic<uint64_t> _dropped{0};
+    std::atomic<uint64_t> _suppressed{0};
+    std::atomic<bool> _stop{false};
+
+    std::mutex _ringsMutex;
+    std::vector<std::unique_ptr<LogRing_t>> _rings;
+    uint32_t _nextThreadIndex = 0;
+
+    std::mutex _drainMutex;
+    std::ostream *_sink = &std::cout;
+    // Copy of _rings taken by _drain, guarded by _drainMutex
+    std::vector<LogRing_t*> _drainRings;
+
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    std::thread _drainThread;
+};
+
+#define GARAGE_LOG(level, ...) GarageLogger::Instance().Log(level, __VA_ARGS__)
@@ -0,0 +1,249 @@
+#include "garageService.hpp"
+#include "garageLog.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+// Spin briefly, then yield, then sleep, so idle threads give the core back
+static void backoff(uint &idleRounds)
+{
+    if (idleRounds < 64)
+    {
+        // Busy wait
+    }
+    else if (idleRounds < 128)
+    {
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    idleRounds++;
+}
+
+void *GarageService::Worker_t::operator new(size_t size)
+{
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignof(Worker_t), size) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void GarageService::Worker_t::operator delete(void *ptr)
+{
+    free(ptr);
+}
+
+// Only instantiated in this file, so defined here ahead of their callers
+template <typename Func>
+GarageRetCode GarageService::_call(int id, Func &&func)
+{
+    if (id < 0 || ShardOf(id) >= _workers.size())
+    {
+        return GarageRetCode::ERR_INVALID_ID;
+    }
+    return _callShard(ShardOf(id), std::forward<Func>(func));
+}
+
+template <typename Func>
+GarageRetCode GarageService::_callShard(uint shard, Func &&func)
+{
+    if (_workers[shard]->failed)
+    {
+        return GarageRetCode::ERR_DATABASE;
+    }
+    // The caller waits on its own flag, so completion touches no shared state.
+    //  The task only captures a pointer to this, so the Task stores it inline
+    //  and the request is moved into the queue without a heap allocation.
+    typedef struct PendingCall_t {
+        typename std::remove_reference<Func>::type *func;
+        GarageRetCode retCode;
+        std::atomic<bool> done;
+    } PendingCall_t;
+    PendingCall_t call;
+    call.func = &func;
+    call.retCode = GarageRetCode::OK;
+    call.done.store(false, std::memory_order_relaxed);
+    Task task = [&call](GarageApi &api) {
+        call.retCode = (*call.func)(api);
+        call.done.store(true, std::memory_order_release);
+    };
+    uint idle_rounds = 0;
+    // A failed Post leaves the task in place, so it can be posted again
+    while (!Post(shard, std::move(task)))
+    {
+        // Queue full, let the worker catch up
+        backoff(idle_rounds);
+    }
+    idle_rounds = 0;
+    while (!call.done.load(std::memory_order_acquire))
+    {
+        backoff(idle_rounds);
+    }
+    return call.retCode;
+}
+
+GarageService::GarageService(uint numShards, GarageConfig_t config, const std::string &dbPathPrefix,
+    GarageRetCode *retCode):
+    _config(config)
+{
+    if (numShards == 0U)
+    {
+        numShards = 1;
+    }
+    if (numShards > MAX_SHARDS)
+    {
+        GARAGE_LOG(LOG_WARN, "GarageService: %u shards requested, using %u", numShards, MAX_SHARDS);
+        numShards = MAX_SHARDS;
+    }
+    std::atomic<int> ready{0};
+    for (uint shard = 0; shard < numShards; shard++)
+    {
+        std::unique_ptr<Worker_t> worker(new Worker_t());
+        worker->shard = shard;
+        std::string db_path = dbPathPrefix + "." + std::to_string(shard) + ".db3";
+        worker->thread = std::thread(&GarageService::_workerLoop, this, worker.get(), db_path, &ready);
+        _workers.push_back(std::move(worker));
+    }
+    // Wait for every shard to open its database
+    uint idle_rounds = 0;
+    while (ready.load(std::memory_order_acquire) < static_cast<int>(numShards))
+    {
+        backoff(idle_rounds);
+    }
+    if (retCode != nullptr)
+    {
+        *retCode = GarageRetCode::OK;
+        for (std::unique_ptr<Worker_t> &worker : _workers)
+        {
+            if (worker->failed)
+            {
+                *retCode = GarageRetCode::ERR_DATABASE;
+            }
+        }
+    }
+}
+
+GarageService::~GarageService()
+{
+    for (std::unique_ptr<Worker_t> &worker : _workers)
+    {
+        worker->stop.store(true, std::memory_order_release);
+    }
+    for (std::unique_ptr<Worker_t> &worker : _workers)
+    {
+        worker->thread.join();
+    }
+}
+
+bool GarageService::Post(uint shard, Task &&task)
+{
+    if (shard >= _workers.size() || _workers[shard]->failed)
+    {
+        return false;
+    }
+    return _workers[shard]->queue.TryPush(std::move(task));
+}
+
+GarageRetCode GarageService::CreateGarage(uint levels, uint rowsPerLevel, uint spotsPerRow, GarageInfo_t &garageInfo)
+{
+    uint first_shard = _nextShard.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+    GarageRetCode ret_code = GarageRetCode::ERR_IDS_EXHAUSTED;
+    // Move on to the next shard if this one has used up its ids
+    for (uint i = 0; i < _workers.size() && ret_code == GarageRetCode::ERR_IDS_EXHAUSTED; i++)
+    {
+        ret_code = _callShard((first_shard + i) % _workers.size(), [&](GarageApi &api) {
+            return api.CreateGarage(levels, rowsPerLevel, spotsPerRow, garageInfo);
+        });
+    }
+    return ret_code;
+}
+
+GarageRetCode GarageService::GetGarageInfo(int garageId, GarageInfo_t &garageInfo)
+{
+    return _call(garageId, [&](GarageApi &api) {
+        return api.GetGarageInfo(garageId, garageInfo);
+    });
+}
+
+GarageRetCode GarageService::GetParkingSpotInfo(int parkingSpotId, ParkingSpotInfo_t &parkingSpotInfo)
+{
+    return _call(parkingSpotId, [&](GarageApi &api) {
+        return api.GetParkingSpotInfo(parkingSpotId, parkingSpotInfo);
+    });
+}
+
+GarageRetCode GarageService::ParkVehicleInGarage(VehicleInfo_t vehicle, int garageId, int &parkingSpotId)
+{
+    return _call(garageId, [&](GarageApi &api) {
+        return api.ParkVehicleInGarage(vehicle, garageId, parkingSpotId);
+    });
+}
+
+GarageRetCode GarageService::ParkVehicleInSpot(VehicleInfo_t vehicle, int parkingSpotId)
+{
+    return _call(parkingSpotId, [&](GarageApi &api) {
+        return api.ParkVehicleInSpot(vehicle, parkingSpotId);
+    });
+}
+
+void GarageService::Reset()
+{
+    for (uint shard = 0; shard < _workers.size(); shard++)
+    {
+        _callShard(shard, [](GarageApi &api) {
+            api.Reset();
+            return GarageRetCode::OK;
+        });
+    }
+}
+
+void GarageService::_workerLoop(Worker_t *worker, std::string dbPath, std::atomic<int> *ready)
+{
+    // The connection is opened and used only on this thread
+    GarageConfig_t config = _config;
+    config.idBase = worker->shard * SHARD_ID_SPAN;
+    // Ids past the span would route to the next shard
+    config.idLimit = (worker->shard + 1) * SHARD_ID_SPAN;
+    sqlite3 *db;
+    if (OpenGarageDb(dbPath, config, &db) != GarageRetCode::OK)
+    {
+        // Nothing is ever queued to a failed shard, so the worker can exit
+        sqlite3_close(db);
+        worker->failed = true;
+        ready->fetch_add(1, std::memory_order_release);
+        return;
+    }
+    GarageApi *api = new GarageApi(db, config);
+    ready->fetch_add(1, std::memory_order_release);
+
+    Task task;
+    uint idle_rounds = 0;
+    for (;;)
+    {
+        if (worker->queue.TryPop(task))
+        {
+            task(*api);
+            task = nullptr;
+            idle_rounds = 0;
+        }
+        else if (worker->stop.load(std::memory_order_acquire))
+        {
+            break;
+        }
+        else
+        {
+            backoff(idle_rounds);
+        }
+    }
+
+    delete api;
+    sqlite3_close(db);
+}
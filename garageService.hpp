@@ -0,0 +1,107 @@
+/*
+ * Garage service definitions.
+ *
+ * Shards garages across worker threads. Each worker owns its own database
+ *  connection and GarageApi, and only ever runs requests for the garages it
+ *  owns, so the request path shares no mutable state beyond the worker's
+ *  request queue.
+ *
+ * Shard k hands out garage and spot ids in [k * SHARD_ID_SPAN + 1, (k + 1) * SHARD_ID_SPAN),
+ *  so any garage or spot id routes to its shard without a lookup. Once a
+ *  shard's span is used up, CreateGarage on it fails with ERR_IDS_EXHAUSTED.
+ */
+#pragma once
+
+#include "garageApi.hpp"
+#include "mpscQueue.hpp"
+
+#include <sqlite3.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class GarageService
+{
+public:
+    static const int  SHARD_ID_SPAN     = 1 << 24;
+    static const uint MAX_SHARDS        = 127;
+    static const size_t QUEUE_CAPACITY  = 4096;
+
+    typedef std::function<void(GarageApi&)> Task;
+
+    /**
+     * Start one worker thread per shard, each with its own database.
+     *
+     * @param numShards Number of worker threads, at most MAX_SHARDS.
+     * @param config Settings for every shard database.
+     * @param dbPathPrefix Shard k uses the database file "<prefix>.<k>.db3".
+     *  Ignored by in-memory profiles.
+     * @param retCode (OUT) ERR_DATABASE if a shard's database failed to open.
+     *  Calls routed to that shard then fail with ERR_DATABASE.
+     * @return service object.
+     */
+    GarageService(uint numShards, GarageConfig_t config, const std::string &dbPathPrefix = "./garages",
+        GarageRetCode *retCode = nullptr);
+    /**
+     * Run every queued request, then stop the workers and close their databases.
+     */
+    ~GarageService();
+
+    uint NumShards() const { return _workers.size(); }
+    /**
+     * @param id Garage or parking spot id.
+     * @return shard owning the id. Not range checked.
+     */
+    static uint ShardOf(int id) { return static_cast<uint>(id / SHARD_ID_SPAN); }
+
+    /**
+     * Queue a task to run on a shard's worker thread. Never blocks.
+     *
+     * @param shard Shard to run the task on.
+     * @param task Called with the shard's GarageApi. Moved from only if queued.
+     * @return false if the shard does not exist, failed to open or its queue is full.
+     */
+    bool Post(uint shard, Task &&task);
+
+    /*
+     * Blocking equivalents of the GarageApi calls, routed to the owning shard.
+     *  New garages are spread across shards round-robin.
+     */
+    GarageRetCode CreateGarage(uint levels, uint rowsPerLevel, uint spotsPerRow, GarageInfo_t &garageInfo);
+    GarageRetCode GetGarageInfo(int garageId, GarageInfo_t &garageInfo);
+    GarageRetCode GetParkingSpotInfo(int parkingSpotId, ParkingSpotInfo_t &parkingSpotInfo);
+    GarageRetCode ParkVehicleInGarage(VehicleInfo_t vehicle, int garageId, int &parkingSpotId);
+    GarageRetCode ParkVehicleInSpot(VehicleInfo_t vehicle, int parkingSpotId);
+    /**
+     * Reset every shard. See GarageApi::Reset.
+     */
+    void Reset();
+
+private:
+    typedef struct Worker_t {
+        uint shard = 0;
+        MpscQueue<Task> queue{QUEUE_CAPACITY};
+        std::atomic<bool> stop{false};
+        // Set before the worker counts itself ready, and never changed after
+        bool failed = false;
+        std::thread thread;
+
+        // The queue is cache line aligned, which plain new only honours from C++17
+        static void *operator new(size_t size);
+        static void operator delete(void *ptr);
+    } Worker_t;
+
+    void    _workerLoop(Worker_t *worker, std::string dbPath, std::atomic<int> *ready);
+    template <typename Func>
+    GarageRetCode _call(int id, Func &&func);
+    template <typename Func>
+    GarageRetCode _callShard(uint shard, Func &&func);
+
+    GarageConfig_t _config;
+    std::vector<std::unique_ptr<Worker_t>> _workers;
+    std::atomic<uint> _nextShard{0};
+};
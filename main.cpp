@@ -1,8 +1,19 @@
 #include "garageApi.hpp"
+#include "garageLog.hpp"
+#include "garageService.hpp"
+#include "occupancyBoard.hpp"
+#include "occupancyRecorder.hpp"
+#include "vehicleClasses.hpp"
 
 #include <sqlite3.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
 
 
 bool testCreateGarage(GarageApi *api)
@@ -139,31 +150,722 @@ bool testParkingSpotInfo(GarageApi *api)
     return is_success;
 }
 
+bool testParkVehicleInSpot(GarageApi *api)
+{
+    api->Reset();
+    bool is_success = true;
+    // 1 level with 3 rows of 5 spots each will guarantee each row is of a different type
+    GarageInfo_t garage_info;
+    is_success = is_success && (GarageRetCode::OK == api->CreateGarage(1, 3, 5, garage_info));
+    SpotBitmap motorcycle_spots;
+    SpotBitmap large_spots;
+    is_success = is_success && (GarageRetCode::OK == api->GetGarageSpots(garage_info.id, 0, SpotType::SPOT_MOTORCYCLE, motorcycle_spots));
+    is_success = is_success && (GarageRetCode::OK == api->GetGarageSpots(garage_info.id, 0, SpotType::SPOT_LARGE, large_spots));
+    std::vector<int> large_ids(large_spots.begin(), large_spots.end());
+    VehicleInfo_t bus = {VehicleType::VEHICLE_BUS};
+    VehicleInfo_t car = {VehicleType::VEHICLE_CAR};
+    VehicleInfo_t motorcycle = {VehicleType::VEHICLE_MOTORCYCLE};
+    // Incompatible spot and vehicle types
+    is_success = is_success && (GarageRetCode::ERR_INVALID_SPOT == api->ParkVehicleInSpot(car, *motorcycle_spots.begin()));
+    is_success = is_success && (GarageRetCode::ERR_INVALID_VEHICLE_TYPE == api->ParkVehicleInSpot({VehicleType::VEHICLE_NONE}, large_ids[0]));
+    is_success = is_success && (GarageRetCode::ERR_INVALID_SPOT_TYPE == api->ParkVehicleInSpot(car, large_ids[4] + 1000));
+    // A bus does not fit past the end of the row
+    is_success = is_success && (GarageRetCode::ERR_INVALID_SPOT == api->ParkVehicleInSpot(bus, large_ids[1]));
+    // A bus needs all 5 spots vacant; a partial match must not park anything,
+    //  and is reported as full whichever spot is taken
+    is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInSpot(motorcycle, large_ids[2]));
+    is_success = is_success && (GarageRetCode::ERR_SPOT_FULL == api->ParkVehicleInSpot(bus, large_ids[0]));
+    is_success = is_success && (GarageRetCode::OK == api->GetGarageInfo(garage_info.id, garage_info));
+    is_success = is_success && (garage_info.spotsFilled.size() == 1);
+    // Once the row is clear the bus fills all 5 spots
+    api->Reset();
+    is_success = is_success && (GarageRetCode::OK == api->CreateGarage(1, 3, 5, garage_info));
+    is_success = is_success && (GarageRetCode::OK == api->GetGarageSpots(garage_info.id, 0, SpotType::SPOT_LARGE, large_spots));
+    is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInSpot(bus, *large_spots.begin()));
+    is_success = is_success && (GarageRetCode::ERR_SPOT_FULL == api->ParkVehicleInSpot(motorcycle, *large_spots.begin()));
+    is_success = is_success && (GarageRetCode::OK == api->GetGarageInfo(garage_info.id, garage_info));
+    is_success = is_success && (garage_info.spotsFilled == large_spots);
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testParkVehicleInSpot: " << result << std::endl;
+    return is_success;
+}
+
+bool testVehicleClasses(GarageApi *api)
+{
+    api->Reset();
+    bool is_success = true;
+    // Compatibility is resolved at compile time
+    static_assert(CanPark<VehicleType::VEHICLE_CAR>(SpotType::SPOT_LARGE), "Cars fit large spots");
+    is_success = is_success && !CanPark(VehicleType::VEHICLE_NONE, SpotType::SPOT_LARGE);
+    is_success = is_success && (FindVehicleClass(VehicleType::VEHICLE_BUS)->footprint == 5);
+    // 1 level with 3 rows of 1 spot each will guarantee each spot is of a different type
+    GarageInfo_t first_garage;
+    GarageInfo_t second_garage;
+    is_success = is_success && (GarageRetCode::OK == api->CreateGarage(1, 3, 1, first_garage));
+    is_success = is_success && (GarageRetCode::OK == api->CreateGarage(1, 3, 1, second_garage));
+    // Vehicles take their most preferred spot type first
+    int parking_spot_id;
+    ParkingSpotInfo_t parking_spot_info;
+    VehicleInfo_t car = {VehicleType::VEHICLE_CAR};
+    VehicleInfo_t motorcycle = {VehicleType::VEHICLE_MOTORCYCLE};
+    is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInGarage(car, first_garage.id, parking_spot_id));
+    is_success = is_success && (GarageRetCode::OK == api->GetParkingSpotInfo(parking_spot_id, parking_spot_info));
+    is_success = is_success && (parking_spot_info.spotType == SpotType::SPOT_COMPACT);
+    is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInGarage(motorcycle, first_garage.id, parking_spot_id));
+    is_success = is_success && (GarageRetCode::OK == api->GetParkingSpotInfo(parking_spot_id, parking_spot_info));
+    is_success = is_success && (parking_spot_info.spotType == SpotType::SPOT_MOTORCYCLE);
+    // Only spots of the requested garage are used
+    is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInGarage(motorcycle, first_garage.id, parking_spot_id));
+    is_success = is_success && (GarageRetCode::ERR_NO_VACANT_SPOT == api->ParkVehicleInGarage(motorcycle, first_garage.id, parking_spot_id));
+    is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInGarage(motorcycle, second_garage.id, parking_spot_id));
+    is_success = is_success && (GarageRetCode::OK == api->GetParkingSpotInfo(parking_spot_id, parking_spot_info));
+    is_success = is_success && (parking_spot_info.garageId == second_garage.id);
+    is_success = is_success && (GarageRetCode::ERR_INVALID_VEHICLE_TYPE == api->ParkVehicleInGarage({VehicleType::VEHICLE_NONE}, second_garage.id, parking_spot_id));
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testVehicleClasses: " << result << std::endl;
+    return is_success;
+}
+
+bool testSpotBitmap(GarageApi *api)
+{
+    api->Reset();
+    bool is_success = true;
+    // Contiguous ids should compress into a single run
+    SpotBitmap spots;
+    for (int id = 1; id <= 10000; id++)
+    {
+        spots.add(id);
+    }
+    spots.add(70000); // Second container
+    spots.runOptimize();
+    is_success = is_success && (spots.size() == 10001);
+    is_success = is_success && (spots.memoryUsage() < 10001 * sizeof(int) / 10);
+    is_success = is_success && spots.contains(5000) && spots.contains(70000);
+    is_success = is_success && !spots.contains(0) && !spots.contains(10001);
+    is_success = is_success && (spots.rank(5000) == 5000);
+    is_success = is_success && (spots.rank(70000) == 10001);
+    // Iteration is ascending and visits every id
+    int expected = 1;
+    for (int id : spots)
+    {
+        is_success = is_success && (id == ((expected <= 10000) ? expected : 70000));
+        expected++;
+    }
+    is_success = is_success && (expected == 10002);
+    // Removing from a run keeps the set consistent
+    spots.remove(5000);
+    is_success = is_success && !spots.contains(5000) && (spots.rank(5001) == 5000);
+    // Vacant large spots of a garage
+    GarageInfo_t garage_info;
+    is_success = is_success && (GarageRetCode::OK == api->CreateGarage(2, 3, 5, garage_info));
+    int parking_spot_id;
+    VehicleInfo_t bus = {VehicleType::VEHICLE_BUS};
+    is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInGarage(bus, garage_info.id, parking_spot_id));
+    is_success = is_success && (GarageRetCode::OK == api->GetGarageInfo(garage_info.id, garage_info));
+    SpotBitmap large_spots;
+    is_success = is_success && (GarageRetCode::OK == api->GetGarageSpots(garage_info.id, -1, SpotType::SPOT_LARGE, large_spots));
+    SpotBitmap vacant_large = garage_info.spotsVacant & large_spots;
+    is_success = is_success && (large_spots.size() == 10) && (vacant_large.size() == 5); // 1 large row per level
+    is_success = is_success && ((garage_info.spotsFilled & large_spots) == garage_info.spotsFilled);
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testSpotBitmap: " << result << std::endl;
+    return is_success;
+}
+
+bool testSpotCursor(GarageApi *api)
+{
+    api->Reset();
+    bool is_success = true;
+    // 2 levels of 3 rows of 5 spots each
+    GarageInfo_t garage_info;
+    is_success = is_success && (GarageRetCode::OK == api->CreateGarage(2, 3, 5, garage_info));
+    int parking_spot_id;
+    VehicleInfo_t bus = {VehicleType::VEHICLE_BUS};
+    is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInGarage(bus, garage_info.id, parking_spot_id));
+    // Page through every spot, 4 at a time, resuming from the token each page
+    std::vector<ParkingSpotInfo_t> page;
+    int token = SPOT_CURSOR_START;
+    int num_pages = 0;
+    int num_spots = 0;
+    int last_id = 0;
+    while (token != SPOT_CURSOR_DONE)
+    {
+        SpotCursor cursor(api, garage_info.id, {}, 4, token);
+        is_success = is_success && (GarageRetCode::OK == cursor.Next(page));
+        is_success = is_success && (page.size() <= 4);
+        for (const ParkingSpotInfo_t &spot : page)
+        {
+            is_success = is_success && (spot.id > last_id) && (spot.garageId == garage_info.id);
+            last_id = spot.id;
+        }
+        num_spots += page.size();
+        num_pages++;
+        token = cursor.Token();
+    }
+    is_success = is_success && (num_spots == 30) && (num_pages == 8);
+    // Filters match GetGarageInfo / GetGarageSpots
+    SpotFilter_t filled_filter = {-1, SpotType::SPOT_NONE, SpotOccupancy::OCCUPANCY_FILLED};
+    SpotBitmap filled;
+    is_success = is_success && (GarageRetCode::OK == api->ForEachSpot(garage_info.id, filled_filter,
+        [&](const ParkingSpotInfo_t &spot) { filled.add(spot.id); return !spot.isVacant; }));
+    is_success = is_success && (GarageRetCode::OK == api->GetGarageInfo(garage_info.id, garage_info));
+    is_success = is_success && (filled == garage_info.spotsFilled);
+    SpotFilter_t large_filter = {1, SpotType::SPOT_LARGE, SpotOccupancy::OCCUPANCY_VACANT};
+    int num_large = 0;
+    is_success = is_success && (GarageRetCode::OK == api->ForEachSpot(garage_info.id, large_filter,
+        [&](const ParkingSpotInfo_t &spot) { num_large++; return spot.level == 1 && spot.spotType == SpotType::SPOT_LARGE; }));
+    is_success = is_success && (num_large == 5);
+    // Stopping early
+    int num_visited = 0;
+    is_success = is_success && (GarageRetCode::OK == api->ForEachSpot(garage_info.id, {},
+        [&](const ParkingSpotInfo_t &spot) { return ++num_visited < 3; }));
+    is_success = is_success && (num_visited == 3);
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testSpotCursor: " << result << std::endl;
+    return is_success;
+}
+
+bool testGarageLog(GarageApi *api)
+{
+    api->Reset();
+    bool is_success = true;
+    GarageLogger &logger = GarageLogger::Instance();
+    std::ostringstream sink;
+    logger.Flush();
+    logger.SetSink(&sink);
+    // Messages below the current level are ignored
+    logger.SetLevel(LogLevel::LOG_INFO);
+    GARAGE_LOG(LOG_DEBUG, "hidden %d", 1);
+    GARAGE_LOG(LOG_WARN, "shown %d", 2);
+    logger.Flush();
+    is_success = is_success && (sink.str().find("hidden") == std::string::npos);
+    is_success = is_success && (sink.str().find("WARN [") != std::string::npos);
+    is_success = is_success && (sink.str().find("shown 2") != std::string::npos);
+    // A burst from one call site is rate limited. The call site is only used
+    //  here, so no earlier message counts against its window.
+    uint64_t suppressed = logger.SuppressedCount();
+    sink.str("");
+    for (int i = 0; i < 20; i++)
+    {
+        GARAGE_LOG(LOG_INFO, "burst %d", i);
+    }
+    logger.Flush();
+    size_t num_lines = 0;
+    for (char c : sink.str())
+    {
+        num_lines += (c == '\n');
+    }
+    is_success = is_success && (num_lines == GarageLogger::RATE_LIMIT_COUNT);
+    is_success = is_success && (logger.SuppressedCount() - suppressed == 20 - GarageLogger::RATE_LIMIT_COUNT);
+    // Each thread logs into its own ring
+    sink.str("");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([t]() { GARAGE_LOG(LOG_INFO, "thread %d", t); });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    logger.Flush();
+    for (int t = 0; t < 4; t++)
+    {
+        is_success = is_success && (sink.str().find("thread " + std::to_string(t)) != std::string::npos);
+    }
+    logger.SetSink(&std::cout);
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testGarageLog: " << result << std::endl;
+    return is_success;
+}
+
+bool testDurabilityProfiles(GarageApi *api)
+{
+    bool is_success = true;
+    const std::string db_path = "./garages_profile_test.db3";
+    const char *profile_names[] = {"strict", "balanced", "ephemeral", "bulk-load"};
+    const char *journal_modes[] = {"delete", "wal", "memory", "memory"};
+    GarageConfig_t config;
+    is_success = is_success && (GarageRetCode::ERR_INVALID_ARGUMENTS == GarageConfigFromName("unknown", config));
+    for (int i = 0; i < 4; i++)
+    {
+        is_success = is_success && (GarageRetCode::OK == GarageConfigFromName(profile_names[i], config));
+        // Create a garage and park 3 cars
+        sqlite3 *db;
+        is_success = is_success && (GarageRetCode::OK == OpenGarageDb(db_path, config, &db));
+        GarageApi *profile_api = new GarageApi(db, config);
+        profile_api->Reset();
+        GarageInfo_t garage_info;
+        is_success = is_success && (GarageRetCode::OK == profile_api->CreateGarage(1, 3, 5, garage_info));
+        int parking_spot_id;
+        VehicleInfo_t car = {VehicleType::VEHICLE_CAR};
+        for (int car_num = 0; car_num < 3; car_num++)
+        {
+            is_success = is_success && (GarageRetCode::OK == profile_api->ParkVehicleInGarage(car, garage_info.id, parking_spot_id));
+        }
+        // Uncommitted batched writes are visible on the same connection
+        is_success = is_success && (GarageRetCode::OK == profile_api->GetGarageInfo(garage_info.id, garage_info));
+        is_success = is_success && (garage_info.spotsFilled.size() == 3);
+        // Check the journal mode was applied
+        std::string journal_mode;
+        sqlite3_exec(db, "PRAGMA journal_mode", [](void *mode, int count, char **data, char **columns) {
+            *static_cast<std::string*>(mode) = data[0];
+            return 0;
+        }, &journal_mode, NULL);
+        is_success = is_success && (journal_mode == journal_modes[i]);
+        delete profile_api;
+        sqlite3_close(db);
+        // Everything but the in-memory profile persists once the API is gone
+        if (!config.inMemory)
+        {
+            is_success = is_success && (GarageRetCode::OK == OpenGarageDb(db_path, config, &db));
+            profile_api = new GarageApi(db, config);
+            is_success = is_success && (GarageRetCode::OK == profile_api->GetGarageInfo(garage_info.id, garage_info));
+            is_success = is_success && (garage_info.spotsFilled.size() == 3);
+            delete profile_api;
+            sqlite3_close(db);
+        }
+        remove(db_path.c_str());
+        remove((db_path + "-wal").c_str());
+        remove((db_path + "-shm").c_str());
+    }
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testDurabilityProfiles: " << result << std::endl;
+    return is_success;
+}
+
+static int countRows(sqlite3 *db, const std::string &table)
+{
+    int count = -1;
+    sqlite3_exec(db, ("SELECT COUNT(*) FROM " + table).c_str(), [](void *count, int num_columns, char **data, char **columns) {
+        *static_cast<int*>(count) = atoi(data[0]);
+        return 0;
+    }, &count, NULL);
+    return count;
+}
+
+bool testCreateGarageRollback(GarageApi *api)
+{
+    bool is_success = true;
+    const std::string db_path = "./garages_rollback_test.db3";
+    const char *profile_names[] = {"strict", "bulk-load"};
+    for (int i = 0; i < 2; i++)
+    {
+        GarageConfig_t config;
+        is_success = is_success && (GarageRetCode::OK == GarageConfigFromName(profile_names[i], config));
+        sqlite3 *db;
+        is_success = is_success && (GarageRetCode::OK == OpenGarageDb(db_path, config, &db));
+        GarageApi *rollback_api = new GarageApi(db, config);
+        rollback_api->Reset();
+        GarageInfo_t garage_info;
+        is_success = is_success && (GarageRetCode::OK == rollback_api->CreateGarage(1, 3, 5, garage_info));
+        is_success = is_success && (GarageRetCode::OK == rollback_api->Commit());
+        // Fail the second row of spots, after the garage and first row are written
+        sqlite3_exec(db, ""
+            "CREATE TEMP TRIGGER fail_spot BEFORE INSERT ON parking_spots WHEN NEW.row = 1"
+            " BEGIN SELECT RAISE(ABORT, 'forced failure'); END", NULL, NULL, NULL);
+        is_success = is_success && (GarageRetCode::ERR_DATABASE == rollback_api->CreateGarage(1, 2, 5, garage_info));
+        is_success = is_success && (countRows(db, "garages") == 1) && (countRows(db, "parking_spots") == 15);
+        // A batch holding the failed garage was rolled back
+        is_success = is_success && (GarageRetCode::OK == rollback_api->Commit()) == (config.commitBatchSize <= 1U);
+        // Later writes are unaffected
+        sqlite3_exec(db, "DROP TRIGGER fail_spot", NULL, NULL, NULL);
+        is_success = is_success && (GarageRetCode::OK == rollback_api->CreateGarage(1, 2, 5, garage_info));
+        is_success = is_success && (GarageRetCode::OK == rollback_api->Commit());
+        is_success = is_success && (countRows(db, "garages") == 2) && (countRows(db, "parking_spots") == 25);
+        delete rollback_api;
+        sqlite3_close(db);
+        remove(db_path.c_str());
+        remove((db_path + "-wal").c_str());
+        remove((db_path + "-shm").c_str());
+    }
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testCreateGarageRollback: " << result << std::endl;
+    return is_success;
+}
+
+bool testGarageService(GarageApi *api)
+{
+    bool is_success = true;
+    // 4 shards, one garage each: 1 level with 3 rows of 1 spot each
+    const uint num_shards = 4;
+    GarageRetCode ret_code = GarageRetCode::ERR_DATABASE;
+    GarageService service(num_shards, GarageConfigForProfile(DurabilityProfile::PROFILE_EPHEMERAL), "./garages", &ret_code);
+    is_success = is_success && (ret_code == GarageRetCode::OK) && (service.NumShards() == num_shards);
+    std::vector<GarageInfo_t> garages(num_shards);
+    for (uint i = 0; i < num_shards; i++)
+    {
+        is_success = is_success && (GarageRetCode::OK == service.CreateGarage(1, 3, 1, garages[i]));
+        is_success = is_success && (GarageService::ShardOf(garages[i].id) == i);
+    }
+    // Park 3 motorcycles per garage from one thread per garage; the 4th should fail
+    std::vector<std::thread> threads;
+    std::vector<int> num_parked(num_shards, 0);
+    std::vector<int> num_wrong_shard(num_shards, 0);
+    for (uint i = 0; i < num_shards; i++)
+    {
+        threads.emplace_back([&, i]() {
+            VehicleInfo_t motorcycle = {VehicleType::VEHICLE_MOTORCYCLE};
+            int parking_spot_id;
+            while (GarageRetCode::OK == service.ParkVehicleInGarage(motorcycle, garages[i].id, parking_spot_id))
+            {
+                num_parked[i]++;
+                num_wrong_shard[i] += (GarageService::ShardOf(parking_spot_id) != i);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    for (uint i = 0; i < num_shards; i++)
+    {
+        is_success = is_success && (num_parked[i] == 3) && (num_wrong_shard[i] == 0);
+        is_success = is_success && (GarageRetCode::OK == service.GetGarageInfo(garages[i].id, garages[i]));
+        is_success = is_success && (garages[i].spotsFilled.size() == 3);
+    }
+    // Ids outside every shard are rejected without reaching a worker
+    ParkingSpotInfo_t parking_spot_info;
+    is_success = is_success && (GarageRetCode::ERR_INVALID_ID == service.GetParkingSpotInfo(num_shards * GarageService::SHARD_ID_SPAN, parking_spot_info));
+    // A shard never hands out ids past its span
+    GarageConfig_t limited_config = GarageConfigForProfile(DurabilityProfile::PROFILE_EPHEMERAL);
+    limited_config.idLimit = 10;
+    sqlite3 *limited_db;
+    is_success = is_success && (GarageRetCode::OK == OpenGarageDb("", limited_config, &limited_db));
+    GarageApi *limited_api = new GarageApi(limited_db, limited_config);
+    GarageInfo_t garage_info;
+    is_success = is_success && (GarageRetCode::OK == limited_api->CreateGarage(1, 1, 5, garage_info));
+    is_success = is_success && (GarageRetCode::ERR_IDS_EXHAUSTED == limited_api->CreateGarage(1, 1, 5, garage_info));
+    is_success = is_success && (GarageRetCode::OK == limited_api->CreateGarage(1, 1, 4, garage_info));
+    is_success = is_success && (*garage_info.spotsVacant.begin() == 6) && (garage_info.spotsVacant.size() == 4);
+    delete limited_api;
+    sqlite3_close(limited_db);
+    // Shards whose database cannot be opened fail every call without running it
+    {
+        GarageService failed_service(2, GarageConfigForProfile(DurabilityProfile::PROFILE_STRICT), "./no_such_dir/garages", &ret_code);
+        is_success = is_success && (ret_code == GarageRetCode::ERR_DATABASE);
+        is_success = is_success && (GarageRetCode::ERR_DATABASE == failed_service.CreateGarage(1, 1, 1, garage_info));
+        is_success = is_success && (GarageRetCode::ERR_DATABASE == failed_service.GetGarageInfo(1, garage_info));
+        is_success = is_success && !failed_service.Post(0, [](GarageApi &api) {});
+    }
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testGarageService: " << result << std::endl;
+    return is_success;
+}
+
+
+bool testOccupancyRecorder(GarageApi *api)
+{
+    api->Reset();
+    bool is_success = true;
+    int64_t now = 1000;
+    OccupancyRecorderConfig_t config;
+    config.secondSamples = 4;
+    config.minuteSamples = 3;
+    config.hourSamples = 2;
+    config.clock = [&now]() { return now; };
+    OccupancyRecorder recorder(config);
+    api->SetOccupancyRecorder(&recorder);
+    // 2 levels with one row of each spot type, 2 spots per row
+    GarageInfo_t garage_info;
+    is_success = is_success && (GarageRetCode::OK == api->CreateGarage(2, 3, 2, garage_info));
+    is_success = is_success && recorder.HasGarage(garage_info.id) && !recorder.HasGarage(garage_info.id + 1);
+    // Park a motorcycle in every spot, one per second
+    VehicleInfo_t motorcycle = {VehicleType::VEHICLE_MOTORCYCLE};
+    for (int spot_id : garage_info.spotsVacant)
+    {
+        now++;
+        is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInSpot(motorcycle, spot_id));
+    }
+    // Failed parks are not recorded
+    now++;
+    is_success = is_success && (GarageRetCode::ERR_SPOT_FULL == api->ParkVehicleInSpot(motorcycle, *garage_info.spotsVacant.begin()));
+    // One sample per second with a change, summed over every level and type
+    std::vector<OccupancySample_t> samples;
+    is_success = is_success && (GarageRetCode::OK == recorder.Query(garage_info.id, -1, SpotType::SPOT_NONE, RESOLUTION_SECOND, 0, 2000, samples));
+    is_success = is_success && (samples.size() == 13);
+    is_success = is_success && (samples.front().timestamp == 1000) && (samples.front().filled == 0);
+    is_success = is_success && (samples.back().timestamp == 1012) && (samples.back().filled == 12);
+    is_success = is_success && (GarageRetCode::OK == recorder.Query(garage_info.id, 0, SpotType::SPOT_NONE, RESOLUTION_SECOND, 0, 2000, samples));
+    is_success = is_success && !samples.empty() && (samples.back().filled == 6);
+    is_success = is_success && (GarageRetCode::OK == recorder.Query(garage_info.id, -1, SpotType::SPOT_LARGE, RESOLUTION_SECOND, 0, 2000, samples));
+    is_success = is_success && !samples.empty() && (samples.back().filled == 4);
+    // Every change falls in the minute starting at 960
+    is_success = is_success && (GarageRetCode::OK == recorder.Query(garage_info.id, -1, SpotType::SPOT_NONE, RESOLUTION_MINUTE, 0, 2000, samples));
+    is_success = is_success && (samples.size() == 1) && (samples[0].timestamp == 960);
+    is_success = is_success && (samples[0].filled == 12) && (samples[0].minFilled == 0) && (samples[0].maxFilled == 12);
+    is_success = is_success && (GarageRetCode::ERR_INVALID_ARGUMENTS == recorder.Query(garage_info.id, -1, SpotType::SPOT_NONE, RESOLUTION_MINUTE, 10, 0, samples));
+    // CSV has a header and one row per stored sample
+    std::ostringstream csv;
+    recorder.ExportCsv(csv, RESOLUTION_SECOND);
+    std::string line;
+    std::istringstream csv_lines(csv.str());
+    std::getline(csv_lines, line);
+    is_success = is_success && (line == "timestamp,garage_id,level,spot_type,filled,min_filled,max_filled");
+    uint num_rows = 0;
+    while (std::getline(csv_lines, line))
+    {
+        num_rows++;
+    }
+    is_success = is_success && (num_rows == 6 * 3);
+    // Binary round trip reads back the same samples in less space
+    std::stringstream binary;
+    recorder.ExportBinary(binary, RESOLUTION_SECOND);
+    is_success = is_success && (binary.str().size() < csv.str().size());
+    OccupancyRecorder imported(config);
+    is_success = is_success && (GarageRetCode::OK == imported.ImportBinary(binary));
+    std::vector<OccupancySample_t> imported_samples;
+    recorder.Query(garage_info.id, -1, SpotType::SPOT_NONE, RESOLUTION_SECOND, 0, 2000, samples);
+    imported.Query(garage_info.id, -1, SpotType::SPOT_NONE, RESOLUTION_SECOND, 0, 2000, imported_samples);
+    is_success = is_success && (samples.size() == imported_samples.size());
+    for (size_t i = 0; is_success && i < samples.size(); i++)
+    {
+        is_success = (samples[i].timestamp == imported_samples[i].timestamp)
+            && (samples[i].filled == imported_samples[i].filled)
+            && (samples[i].minFilled == imported_samples[i].minFilled)
+            && (samples[i].maxFilled == imported_samples[i].maxFilled);
+    }
+    std::istringstream garbage("not an export");
+    is_success = is_success && (GarageRetCode::ERR_INVALID_ARGUMENTS == imported.ImportBinary(garbage));
+    // A truncated export is rejected without changing what was imported before
+    std::istringstream truncated(binary.str().substr(0, binary.str().size() - 3));
+    is_success = is_success && (GarageRetCode::ERR_INVALID_ARGUMENTS == imported.ImportBinary(truncated));
+    imported.Query(garage_info.id, -1, SpotType::SPOT_NONE, RESOLUTION_SECOND, 0, 2000, imported_samples);
+    is_success = is_success && (samples.size() == imported_samples.size());
+    for (size_t i = 0; is_success && i < samples.size(); i++)
+    {
+        is_success = (samples[i].timestamp == imported_samples[i].timestamp)
+            && (samples[i].filled == imported_samples[i].filled);
+    }
+    // Importing replaces the whole tier, including series not in the input
+    OccupancyRecorder other(config);
+    other.Set(garage_info.id + 1, 0, SpotType::SPOT_LARGE, 1);
+    std::stringstream other_binary;
+    other.ExportBinary(other_binary, RESOLUTION_SECOND);
+    is_success = is_success && (GarageRetCode::OK == imported.ImportBinary(other_binary));
+    imported.Query(garage_info.id, -1, SpotType::SPOT_NONE, RESOLUTION_SECOND, 0, 2000, imported_samples);
+    is_success = is_success && imported_samples.empty();
+    imported.Query(garage_info.id + 1, -1, SpotType::SPOT_NONE, RESOLUTION_SECOND, 0, 2000, imported_samples);
+    is_success = is_success && (imported_samples.size() == 1) && (imported_samples[0].filled == 1);
+    // Full rings drop their oldest samples, so memory stays bounded
+    OccupancyRecorder ring(config);
+    for (now = 0; now < 10; now++)
+    {
+        ring.Set(1, 0, SpotType::SPOT_LARGE, now);
+    }
+    ring.Query(1, -1, SpotType::SPOT_NONE, RESOLUTION_SECOND, 0, 100, samples);
+    is_success = is_success && (samples.size() == 4) && (samples.front().timestamp == 6) && (samples.front().filled == 6);
+    ring.Query(1, -1, SpotType::SPOT_NONE, RESOLUTION_SECOND, 8, 100, samples);
+    is_success = is_success && (samples.size() == 2) && (samples.front().filled == 8);
+    ring.Query(1, -1, SpotType::SPOT_NONE, RESOLUTION_HOUR, 0, 100, samples);
+    is_success = is_success && (samples.size() == 1) && (samples[0].minFilled == 0) && (samples[0].maxFilled == 9);
+    for (now = 10; now < 100000; now += 7)
+    {
+        ring.Set(1, 0, SpotType::SPOT_LARGE, now % 50);
+    }
+    size_t memory_usage = ring.MemoryUsage();
+    for (now = 100000; now < 1000000; now += 7)
+    {
+        ring.Set(1, 0, SpotType::SPOT_LARGE, now % 50);
+    }
+    is_success = is_success && (ring.MemoryUsage() == memory_usage);
+    // Reset forgets recorded occupancy
+    api->Reset();
+    is_success = is_success && !recorder.HasGarage(garage_info.id);
+    api->SetOccupancyRecorder(nullptr);
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testOccupancyRecorder: " << result << std::endl;
+    return is_success;
+}
+
+// Runs in a forked child: reads the board until every spot is filled,
+//  checking that each snapshot is consistent. Returns the exit status.
+static int boardReaderProcess(const std::string &boardName, int garageId, int readyFd)
+{
+    OccupancyBoard *board = nullptr;
+    if (OccupancyBoard::Open(boardName, &board) != GarageRetCode::OK)
+    {
+        return 1;
+    }
+    char ready = 1;
+    bool is_success = (write(readyFd, &ready, 1) == 1);
+    int last_vacant = -1;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (is_success && last_vacant != 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        BoardSnapshot_t snapshot;
+        if (board->ReadGarage(garageId, snapshot) != GarageRetCode::OK)
+        {
+            continue;
+        }
+        // Levels always add up to the totals, which a torn read would break
+        int vacant = snapshot.Vacant(-1, SpotType::SPOT_NONE);
+        int level_sum = 0;
+        for (uint level = 0; level < snapshot.levels; level++)
+        {
+            level_sum += snapshot.Vacant(level, SpotType::SPOT_NONE);
+        }
+        is_success = (level_sum == vacant) && (vacant >= 0) && (vacant <= snapshot.Spots(-1, SpotType::SPOT_NONE));
+        // Spots are only ever filled
+        is_success = is_success && (last_vacant < 0 || vacant <= last_vacant);
+        last_vacant = vacant;
+    }
+    delete board;
+    return (is_success && last_vacant == 0) ? 0 : 2;
+}
+
+bool testOccupancyBoard(GarageApi *api)
+{
+    api->Reset();
+    bool is_success = true;
+    std::string board_name = "/garage_board_test_" + std::to_string(getpid());
+    OccupancyBoard *reader = nullptr;
+    is_success = is_success && (GarageRetCode::ERR_SHARED_MEMORY == OccupancyBoard::Open(board_name, &reader));
+    OccupancyBoard *board = nullptr;
+    is_success = is_success && (GarageRetCode::OK == OccupancyBoard::Create(board_name, &board));
+    if (!is_success)
+    {
+        std::cout << "testOccupancyBoard: FAILED" << std::endl;
+        return false;
+    }
+    api->SetOccupancyBoard(board);
+    // 2 levels with one row of each spot type, 20 spots per row
+    GarageInfo_t garage_info;
+    is_success = is_success && (GarageRetCode::OK == api->CreateGarage(2, 3, 20, garage_info));
+    is_success = is_success && (GarageRetCode::OK == OccupancyBoard::Open(board_name, &reader));
+    BoardSnapshot_t snapshot;
+    is_success = is_success && (GarageRetCode::OK == reader->ReadGarage(garage_info.id, snapshot));
+    is_success = is_success && (snapshot.levels == 2) && (snapshot.Spots(-1, SpotType::SPOT_NONE) == 120);
+    is_success = is_success && (snapshot.Vacant(-1, SpotType::SPOT_NONE) == 120) && (snapshot.Vacant(1, SpotType::SPOT_LARGE) == 20);
+    is_success = is_success && (GarageRetCode::ERR_INVALID_ID == reader->ReadGarage(garage_info.id + 1, snapshot));
+    // Readers cannot write
+    is_success = is_success && (GarageRetCode::ERR_INVALID_ARGUMENTS == reader->AdjustVacant(garage_info.id, 0, SpotType::SPOT_LARGE, 1));
+    // A reader process checks every snapshot while this process parks a car
+    //  in each compact spot and a motorcycle in every other spot
+    int ready_pipe[2];
+    is_success = is_success && (pipe(ready_pipe) == 0);
+    std::cout << std::flush;
+    pid_t reader_pid = is_success ? fork() : -1;
+    if (reader_pid == 0)
+    {
+        close(ready_pipe[0]);
+        _exit(boardReaderProcess(board_name, garage_info.id, ready_pipe[1]));
+    }
+    is_success = is_success && (reader_pid > 0);
+    close(ready_pipe[1]);
+    char ready = 0;
+    is_success = is_success && (read(ready_pipe[0], &ready, 1) == 1);
+    close(ready_pipe[0]);
+    uint32_t sequence = snapshot.sequence;
+    for (int spot_id : garage_info.spotsVacant)
+    {
+        ParkingSpotInfo_t parking_spot_info;
+        api->GetParkingSpotInfo(spot_id, parking_spot_info);
+        VehicleInfo_t vehicle = {parking_spot_info.spotType == SpotType::SPOT_COMPACT ? VehicleType::VEHICLE_CAR : VehicleType::VEHICLE_MOTORCYCLE};
+        is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInSpot(vehicle, spot_id));
+    }
+    int status = -1;
+    is_success = is_success && (waitpid(reader_pid, &status, 0) == reader_pid);
+    is_success = is_success && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+    // Final counts match the database
+    is_success = is_success && (GarageRetCode::OK == reader->ReadGarage(garage_info.id, snapshot));
+    is_success = is_success && (snapshot.Vacant(-1, SpotType::SPOT_NONE) == 0) && (snapshot.sequence != sequence);
+    is_success = is_success && (snapshot.Spots(0, SpotType::SPOT_COMPACT) == 20);
+    // Garages past a full board are left off it, with one warning rather than one per park
+    for (uint i = 1; i < BOARD_MAX_GARAGES; i++)
+    {
+        GarageInfo_t filler_info;
+        is_success = is_success && (GarageRetCode::OK == api->CreateGarage(1, 1, 1, filler_info));
+    }
+    GarageLogger &logger = GarageLogger::Instance();
+    std::ostringstream sink;
+    logger.Flush();
+    logger.SetSink(&sink);
+    GarageInfo_t unpublished_info;
+    is_success = is_success && (GarageRetCode::OK == api->CreateGarage(1, 1, 3, unpublished_info));
+    VehicleInfo_t motorcycle = {VehicleType::VEHICLE_MOTORCYCLE};
+    for (int spot_id : unpublished_info.spotsVacant)
+    {
+        is_success = is_success && (GarageRetCode::OK == api->ParkVehicleInSpot(motorcycle, spot_id));
+    }
+    logger.Flush();
+    logger.SetSink(&std::cout);
+    size_t num_warnings = 0;
+    for (size_t pos = sink.str().find("Occupancy board full"); pos != std::string::npos;
+        pos = sink.str().find("Occupancy board full", pos + 1))
+    {
+        num_warnings++;
+    }
+    is_success = is_success && (num_warnings == 1);
+    is_success = is_success && (GarageRetCode::ERR_INVALID_ID == reader->ReadGarage(unpublished_info.id, snapshot));
+    // Reset clears the board
+    api->Reset();
+    is_success = is_success && (GarageRetCode::ERR_INVALID_ID == reader->ReadGarage(garage_info.id, snapshot));
+    api->SetOccupancyBoard(nullptr);
+    delete reader;
+    delete board;
+    OccupancyBoard::Unlink(board_name);
+    // Report results
+    std::string result = is_success ? "PASSED" : "FAILED";
+    std::cout << "testOccupancyBoard: " << result << std::endl;
+    return is_success;
+}
+
 
 int main(int argc, char **argv)
 {
     std::string db_path = "./garages.db3";
-    if (argc == 2)
+    std::string profile_name = "strict";
+    if (argc >= 2)
     {
         db_path = std::string(argv[1]);
     }
+    if (argc >= 3)
+    {
+        profile_name = std::string(argv[2]);
+    }
 
+    GarageConfig_t config;
+    if (GarageConfigFromName(profile_name, config) != GarageRetCode::OK)
+    {
+        std::cout << "Unknown durability profile: " << profile_name << std::endl;
+        return 1;
+    }
     sqlite3 *db;
-    int dbRetCode = sqlite3_open(db_path.c_str(), &db);
-    if (dbRetCode)
+    if (OpenGarageDb(db_path, config, &db) != GarageRetCode::OK)
     {
         std::cout << "Can't open database file: " << db_path << std::endl;
         std::cout << "Error code: " << sqlite3_errmsg(db) << std::endl;
     }
 
-    GarageApi *api = new GarageApi(db);
+    GarageApi *api = new GarageApi(db, config);
 
     testCreateGarage(api);
     testParkMotorcycle(api);
     testParkCar(api);
     testParkBus(api);
     testParkingSpotInfo(api);
+    testParkVehicleInSpot(api);
+    testVehicleClasses(api);
+    testSpotBitmap(api);
+    testSpotCursor(api);
+    testGarageLog(api);
+    testDurabilityProfiles(api);
+    testCreateGarageRollback(api);
+    testGarageService(api);
+    testOccupancyRecorder(api);
+    testOccupancyBoard(api);
 
     delete api;
+    GarageLogger::Instance().Flush();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+/*
+ * Bounded lock-free multi-producer single-consumer queue.
+ *
+ * Each slot carries a sequence number that tells producers and the consumer
+ *  whose turn it is, so neither side ever takes a lock. Producers claim a
+ *  slot with one compare-and-swap on the tail; the consumer never contends.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+
+template <typename T>
+class MpscQueue
+{
+public:
+    /**
+     * @param capacity Number of slots, rounded up to a power of 2.
+     */
+    explicit MpscQueue(size_t capacity)
+    {
+        size_t slots = 2;
+        while (slots < capacity)
+        {
+            slots <<= 1;
+        }
+        _mask = slots - 1;
+        _slots.reset(new Slot[slots]);
+        for (size_t i = 0; i < slots; i++)
+        {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Add an item. Safe to call from any thread.
+     *
+     * @return false if the queue is full; the item is left untouched.
+     */
+    bool TryPush(T &&item)
+    {
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot &slot = _slots[pos & _mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.item = std::move(item);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Remove the oldest item. Only the single consumer thread may call this.
+     *
+     * @return false if the queue is empty.
+     */
+    bool TryPop(T &item)
+    {
+        Slot &slot = _slots[_head & _mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != _head + 1)
+        {
+            return false;
+        }
+        item = std::move(slot.item);
+        slot.sequence.store(_head + _mask + 1, std::memory_order_release);
+        _head++;
+        return true;
+    }
+
+private:
+    typedef struct Slot {
+        std::atomic<size_t> sequence{0};
+        T item{};
+    } Slot;
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask = 0;
+    alignas(64) std::atomic<size_t> _tail{0};
+    alignas(64) size_t _head = 0;
+};
@@ -0,0 +1,301 @@
+#include "occupancyBoard.hpp"
+#include "garageLog.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <thread>
+
+
+static int sumCounts(const int (&counts)[BOARD_MAX_LEVELS + 1][BOARD_SPOT_TYPES], int level, SpotType spotType)
+{
+    if (level >= static_cast<int>(BOARD_MAX_LEVELS))
+    {
+        return 0;
+    }
+    uint row = (level < 0) ? BOARD_TOTAL_ROW : level;
+    if (spotType != SpotType::SPOT_NONE)
+    {
+        uint type_index = spotType - SPOT_NONE;
+        return (type_index < BOARD_SPOT_TYPES) ? counts[row][type_index] : 0;
+    }
+    int sum = 0;
+    for (uint type_index = 1; type_index < BOARD_SPOT_TYPES; type_index++)
+    {
+        sum += counts[row][type_index];
+    }
+    return sum;
+}
+
+int BoardSnapshot_t::Vacant(int level, SpotType spotType) const
+{
+    return sumCounts(vacant, level, spotType);
+}
+
+int BoardSnapshot_t::Spots(int level, SpotType spotType) const
+{
+    return sumCounts(spots, level, spotType);
+}
+
+OccupancyBoard::OccupancyBoard(BoardSegment_t *segment, bool writable):
+    _segment(segment),
+    _writable(writable)
+{
+}
+
+OccupancyBoard::~OccupancyBoard()
+{
+    munmap(_segment, sizeof(BoardSegment_t));
+}
+
+GarageRetCode OccupancyBoard::Create(const std::string &name, OccupancyBoard **board)
+{
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        GARAGE_LOG(LOG_ERROR, "Failure creating shared memory %s", name.c_str());
+        return GarageRetCode::ERR_SHARED_MEMORY;
+    }
+    void *mapping = MAP_FAILED;
+    if (ftruncate(fd, sizeof(BoardSegment_t)) == 0)
+    {
+        mapping = mmap(NULL, sizeof(BoardSegment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        GARAGE_LOG(LOG_ERROR, "Failure mapping shared memory %s", name.c_str());
+        return GarageRetCode::ERR_SHARED_MEMORY;
+    }
+
+    // Readers of a previous writer may still have the segment mapped, so
+    //  slots are cleared through their seqlocks rather than zeroed
+    BoardSegment_t *segment = static_cast<BoardSegment_t*>(mapping);
+    segment->magic.store(0, std::memory_order_relaxed);
+    segment->version = BOARD_VERSION;
+    segment->maxGarages = BOARD_MAX_GARAGES;
+    segment->maxLevels = BOARD_MAX_LEVELS;
+    *board = new OccupancyBoard(segment, true);
+    (*board)->Clear();
+    segment->magic.store(BOARD_MAGIC, std::memory_order_release);
+    return GarageRetCode::OK;
+}
+
+GarageRetCode OccupancyBoard::Open(const std::string &name, OccupancyBoard **board)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return GarageRetCode::ERR_SHARED_MEMORY;
+    }
+    struct stat fd_stat;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &fd_stat) == 0 && fd_stat.st_size >= static_cast<off_t>(sizeof(BoardSegment_t)))
+    {
+        mapping = mmap(NULL, sizeof(BoardSegment_t), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return GarageRetCode::ERR_SHARED_MEMORY;
+    }
+
+    BoardSegment_t *segment = static_cast<BoardSegment_t*>(mapping);
+    if (segment->magic.load(std::memory_order_acquire) != BOARD_MAGIC
+        || segment->version != BOARD_VERSION
+        || segment->maxGarages != BOARD_MAX_GARAGES
+        || segment->maxLevels != BOARD_MAX_LEVELS)
+    {
+        GARAGE_LOG(LOG_WARN, "Shared memory %s is not a version %u occupancy board", name.c_str(), BOARD_VERSION);
+        munmap(mapping, sizeof(BoardSegment_t));
+        return GarageRetCode::ERR_SHARED_MEMORY;
+    }
+    *board = new OccupancyBoard(segment, false);
+    return GarageRetCode::OK;
+}
+
+void OccupancyBoard::Unlink(const std::string &name)
+{
+    shm_unlink(name.c_str());
+}
+
+GarageRetCode OccupancyBoard::PublishGarage(int garageId, uint levels, const std::vector<BoardCount_t> &counts)
+{
+    if (!_writable || garageId <= 0)
+    {
+        return GarageRetCode::ERR_INVALID_ARGUMENTS;
+    }
+    // Sum into a local copy first so the slot is written in one short pass
+    int spots[BOARD_MAX_LEVELS + 1][BOARD_SPOT_TYPES] = {};
+    int vacant[BOARD_MAX_LEVELS + 1][BOARD_SPOT_TYPES] = {};
+    for (const BoardCount_t &count : counts)
+    {
+        uint type_index = count.spotType - SPOT_NONE;
+        if (type_index == 0U || type_index >= BOARD_SPOT_TYPES)
+        {
+            return GarageRetCode::ERR_INVALID_SPOT_TYPE;
+        }
+        if (count.level < BOARD_MAX_LEVELS)
+        {
+            spots[count.level][type_index] += count.spots;
+            vacant[count.level][type_index] += count.vacant;
+        }
+        spots[BOARD_TOTAL_ROW][type_index] += count.spots;
+        vacant[BOARD_TOTAL_ROW][type_index] += count.vacant;
+    }
+    BoardSlot_t *slot = _findSlot(garageId, true);
+    if (slot == nullptr)
+    {
+        GARAGE_LOG(LOG_WARN, "Occupancy board full, garage %d not published", garageId);
+        return GarageRetCode::ERR_SHARED_MEMORY;
+    }
+
+    _beginWrite(*slot);
+    slot->garageId.store(garageId, std::memory_order_relaxed);
+    slot->levels.store(levels, std::memory_order_relaxed);
+    for (uint row = 0; row <= BOARD_TOTAL_ROW; row++)
+    {
+        for (uint type_index = 0; type_index < BOARD_SPOT_TYPES; type_index++)
+        {
+            slot->spots[row][type_index].store(spots[row][type_index], std::memory_order_relaxed);
+            slot->vacant[row][type_index].store(vacant[row][type_index], std::memory_order_relaxed);
+        }
+    }
+    _endWrite(*slot);
+    return GarageRetCode::OK;
+}
+
+GarageRetCode OccupancyBoard::AdjustVacant(int garageId, uint level, SpotType spotType, int delta)
+{
+    if (!_writable)
+    {
+        return GarageRetCode::ERR_INVALID_ARGUMENTS;
+    }
+    uint type_index = spotType - SPOT_NONE;
+    if (type_index == 0U || type_index >= BOARD_SPOT_TYPES)
+    {
+        return GarageRetCode::ERR_INVALID_SPOT_TYPE;
+    }
+    BoardSlot_t *slot = _findSlot(garageId, false);
+    if (slot == nullptr)
+    {
+        return GarageRetCode::ERR_INVALID_ID;
+    }
+
+    // Only this process writes, so plain load and store pairs are enough
+    _beginWrite(*slot);
+    if (level < BOARD_MAX_LEVELS)
+    {
+        std::atomic<int32_t> &level_vacant = slot->vacant[level][type_index];
+        level_vacant.store(level_vacant.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    std::atomic<int32_t> &total_vacant = slot->vacant[BOARD_TOTAL_ROW][type_index];
+    total_vacant.store(total_vacant.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    _endWrite(*slot);
+    return GarageRetCode::OK;
+}
+
+void OccupancyBoard::Clear()
+{
+    if (!_writable)
+    {
+        return;
+    }
+    for (BoardSlot_t &slot : _segment->slots)
+    {
+        _beginWrite(slot);
+        slot.garageId.store(0, std::memory_order_relaxed);
+        slot.levels.store(0, std::memory_order_relaxed);
+        for (uint row = 0; row <= BOARD_TOTAL_ROW; row++)
+        {
+            for (uint type_index = 0; type_index < BOARD_SPOT_TYPES; type_index++)
+            {
+                slot.spots[row][type_index].store(0, std::memory_order_relaxed);
+                slot.vacant[row][type_index].store(0, std::memory_order_relaxed);
+            }
+        }
+        _endWrite(slot);
+    }
+}
+
+bool OccupancyBoard::HasGarage(int garageId) const
+{
+    return _findSlot(garageId, false) != nullptr;
+}
+
+GarageRetCode OccupancyBoard::ReadGarage(int garageId, BoardSnapshot_t &snapshot) const
+{
+    const BoardSlot_t *slot = _findSlot(garageId, false);
+    if (slot == nullptr)
+    {
+        return GarageRetCode::ERR_INVALID_ID;
+    }
+    for (uint attempt = 0; attempt < BOARD_READ_RETRIES; attempt++)
+    {
+        uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence & 1U)
+        {
+            // Writer is mid-update
+            std::this_thread::yield();
+            continue;
+        }
+        snapshot.garageId = slot->garageId.load(std::memory_order_relaxed);
+        snapshot.levels = slot->levels.load(std::memory_order_relaxed);
+        for (uint row = 0; row <= BOARD_TOTAL_ROW; row++)
+        {
+            for (uint type_index = 0; type_index < BOARD_SPOT_TYPES; type_index++)
+            {
+                snapshot.spots[row][type_index] = slot->spots[row][type_index].load(std::memory_order_relaxed);
+                snapshot.vacant[row][type_index] = slot->vacant[row][type_index].load(std::memory_order_relaxed);
+            }
+        }
+        // Keep the copy above from being reordered after the re-check
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) == sequence)
+        {
+            snapshot.sequence = sequence;
+            // The slot may have been cleared since it was found
+            return (snapshot.garageId == garageId) ? GarageRetCode::OK : GarageRetCode::ERR_INVALID_ID;
+        }
+    }
+    return GarageRetCode::ERR_BUSY;
+}
+
+BoardSlot_t *OccupancyBoard::_findSlot(int garageId, bool claim) const
+{
+    if (garageId <= 0)
+    {
+        return nullptr;
+    }
+    // Open addressing; slots are only freed all at once by Clear, so a free
+    //  slot ends every probe sequence
+    uint start = static_cast<uint>(garageId) % BOARD_MAX_GARAGES;
+    for (uint i = 0; i < BOARD_MAX_GARAGES; i++)
+    {
+        BoardSlot_t &slot = _segment->slots[(start + i) % BOARD_MAX_GARAGES];
+        int slot_garage_id = slot.garageId.load(std::memory_order_relaxed);
+        if (slot_garage_id == garageId)
+        {
+            return &slot;
+        }
+        if (slot_garage_id == 0)
+        {
+            return claim ? &slot : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+void OccupancyBoard::_beginWrite(BoardSlot_t &slot)
+{
+    // Forced odd, in case a writer that crashed mid-update left it odd already
+    slot.sequence.store((slot.sequence.load(std::memory_order_relaxed) + 1) | 1U, std::memory_order_relaxed);
+    // Readers that see any of the following stores also see the odd sequence
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void OccupancyBoard::_endWrite(BoardSlot_t &slot)
+{
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
@@ -0,0 +1,155 @@
+/*
+ * Occupancy board definitions.
+ *
+ * Publishes live spot and vacancy counts per garage, level and spot type in
+ *  a POSIX shared memory segment, so other processes (display boards,
+ *  billing, metrics) can read them without opening the database. Each
+ *  garage slot is guarded by a seqlock: the single writing process bumps
+ *  the slot's sequence to odd, updates the counts and bumps it back to
+ *  even, and readers retry any copy that overlapped a write. Readers never
+ *  block the writer and the writer never waits for readers.
+ *
+ * Readers only need this header, occupancyBoard.cpp, garageLog.cpp and -lrt.
+ */
+#pragma once
+
+#include "garageApi.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+const uint32_t BOARD_MAGIC = 0x47424f44;    // "GBOD"
+const uint32_t BOARD_VERSION = 1;
+const uint BOARD_MAX_GARAGES = 64;
+// Levels past this are only counted in the garage totals
+const uint BOARD_MAX_LEVELS = 32;
+// Indexed by spotType - SPOT_NONE; index 0 is unused
+const uint BOARD_SPOT_TYPES = 4;
+// Row of each slot holding the whole garage
+const uint BOARD_TOTAL_ROW = BOARD_MAX_LEVELS;
+// Copies a reader attempts before giving up on a slot that never settles
+const uint BOARD_READ_RETRIES = 1000;
+
+// ATOMIC_INT_LOCK_FREE rather than is_always_lock_free, which needs C++17
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && sizeof(int) == sizeof(int32_t),
+    "Shared memory counters must be lock-free to be shared between processes");
+
+// Layout of the shared segment; only atomics, so it is position independent
+typedef struct BoardSlot_t {
+    std::atomic<uint32_t> sequence;     // Odd while the writer is updating the slot
+    std::atomic<int32_t>  garageId;     // 0 for a free slot
+    std::atomic<uint32_t> levels;
+    std::atomic<int32_t>  spots[BOARD_MAX_LEVELS + 1][BOARD_SPOT_TYPES];
+    std::atomic<int32_t>  vacant[BOARD_MAX_LEVELS + 1][BOARD_SPOT_TYPES];
+} BoardSlot_t;
+
+typedef struct BoardSegment_t {
+    std::atomic<uint32_t> magic;        // Stored last, once the segment is initialized
+    uint32_t version;
+    uint32_t maxGarages;
+    uint32_t maxLevels;
+    BoardSlot_t slots[BOARD_MAX_GARAGES];
+} BoardSegment_t;
+
+// One row of grouped counts, as published by the writer
+typedef struct BoardCount_t {
+    uint level          = 0;
+    SpotType spotType   = SPOT_NONE;
+    int spots           = 0;
+    int vacant          = 0;
+} BoardCount_t;
+
+// Consistent copy of one garage's counts
+typedef struct BoardSnapshot_t {
+    int garageId    = 0;
+    uint levels     = 0;
+    uint32_t sequence = 0;  // Changes whenever the garage's counts change
+    int spots[BOARD_MAX_LEVELS + 1][BOARD_SPOT_TYPES] = {};
+    int vacant[BOARD_MAX_LEVELS + 1][BOARD_SPOT_TYPES] = {};
+
+    /**
+     * @param level Zero-based level, or -1 for the whole garage.
+     * @param spotType Spot type, or SPOT_NONE for every type.
+     * @return vacant spots matching, or 0 for levels that are not published.
+     */
+    int Vacant(int level, SpotType spotType) const;
+    /**
+     * @return spots matching, as with Vacant.
+     */
+    int Spots(int level, SpotType spotType) const;
+} BoardSnapshot_t;
+
+class OccupancyBoard
+{
+public:
+    ~OccupancyBoard();
+
+    /**
+     * Create (or take over) a shared memory segment and clear it for writing.
+     *  Only one process should write to a segment.
+     *
+     * @param name POSIX shared memory name, e.g. "/garages".
+     * @param board (OUT) Writable board, owned by the caller.
+     * @return relevant return code.
+     */
+    static GarageRetCode Create(const std::string &name, OccupancyBoard **board);
+    /**
+     * Map an existing segment read-only.
+     *
+     * @param name POSIX shared memory name passed to Create.
+     * @param board (OUT) Read-only board, owned by the caller.
+     * @return relevant return code.
+     */
+    static GarageRetCode Open(const std::string &name, OccupancyBoard **board);
+    /**
+     * Remove the segment name; mapped boards stay valid until deleted.
+     */
+    static void Unlink(const std::string &name);
+
+    /**
+     * Replace every count of a garage in one update.
+     *
+     * @param garageId ID of the parking garage.
+     * @param levels Number of levels in the garage.
+     * @param counts Spots and vacant spots per level and spot type.
+     * @return relevant return code.
+     */
+    GarageRetCode PublishGarage(int garageId, uint levels, const std::vector<BoardCount_t> &counts);
+    /**
+     * Change the vacant count of one level and spot type of a published garage.
+     *
+     * @return relevant return code.
+     */
+    GarageRetCode AdjustVacant(int garageId, uint level, SpotType spotType, int delta);
+    /**
+     * Remove every garage.
+     */
+    void Clear();
+
+    /**
+     * @return true if the garage has been published.
+     */
+    bool HasGarage(int garageId) const;
+    /**
+     * Copy a consistent snapshot of a garage's counts, retrying while the
+     *  writer is updating it.
+     *
+     * @param garageId ID of the requested parking garage.
+     * @param snapshot (OUT) Populated with the garage's counts.
+     * @return relevant return code.
+     */
+    GarageRetCode ReadGarage(int garageId, BoardSnapshot_t &snapshot) const;
+
+private:
+    OccupancyBoard(BoardSegment_t *segment, bool writable);
+
+    BoardSlot_t *_findSlot(int garageId, bool claim) const;
+    void _beginWrite(BoardSlot_t &slot);
+    void _endWrite(BoardSlot_t &slot);
+
+    BoardSegment_t *_segment;
+    bool _writable;
+};
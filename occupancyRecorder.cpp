@@ -0,0 +1,394 @@
+#include "occupancyRecorder.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+
+static const int64_t TIER_RESOLUTIONS[] = {1, 60, 3600};
+static const char BINARY_MAGIC[4] = {'G', 'O', 'C', 'C'};
+static const uint8_t BINARY_VERSION = 1;
+
+static void writeVarint(std::ostream &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.put(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.put(static_cast<char>(value));
+}
+
+static void writeSigned(std::ostream &out, int64_t value)
+{
+    // Zigzag so small negative deltas stay small
+    writeVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+static bool readVarint(std::istream &in, uint64_t &value)
+{
+    value = 0;
+    for (uint shift = 0; shift < 64; shift += 7)
+    {
+        int byte = in.get();
+        if (byte == EOF)
+        {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool readSigned(std::istream &in, int64_t &value)
+{
+    uint64_t raw;
+    if (!readVarint(in, raw))
+    {
+        return false;
+    }
+    value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    return true;
+}
+
+void OccupancyRecorder::Tier_t::push(const OccupancySample_t &sample)
+{
+    if (samples.size() < capacity)
+    {
+        samples.push_back(sample);
+        return;
+    }
+    baseFilled = samples[head].filled;
+    samples[head] = sample;
+    head = (head + 1) % capacity;
+}
+
+OccupancyRecorder::OccupancyRecorder(OccupancyRecorderConfig_t config):
+    _config(config)
+{
+    if (!_config.clock)
+    {
+        _config.clock = []() {
+            return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+        };
+    }
+}
+
+bool OccupancyRecorder::HasGarage(int garageId) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _series.lower_bound(SeriesKey(garageId, INT32_MIN, INT32_MIN));
+    return it != _series.end() && std::get<0>(it->first) == garageId;
+}
+
+void OccupancyRecorder::Set(int garageId, int level, SpotType spotType, int filled)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _record(_getSeries(garageId, level, spotType), filled);
+}
+
+void OccupancyRecorder::Adjust(int garageId, int level, SpotType spotType, int delta)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Series_t &series = _getSeries(garageId, level, spotType);
+    _record(series, series.filled + delta);
+}
+
+void OccupancyRecorder::Clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _series.clear();
+}
+
+GarageRetCode OccupancyRecorder::Query(int garageId, int level, SpotType spotType, OccupancyResolution resolution,
+    int64_t from, int64_t to, std::vector<OccupancySample_t> &samples) const
+{
+    samples.clear();
+    uint tier_index = _tierIndex(resolution);
+    if (tier_index >= NUM_TIERS || from > to)
+    {
+        return GarageRetCode::ERR_INVALID_ARGUMENTS;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Matching tiers, each with the position of its first sample in range and
+    //  the value carried into the range
+    typedef struct Cursor_t {
+        const Tier_t *tier;
+        size_t index;
+        int carry;
+    } Cursor_t;
+    std::vector<Cursor_t> cursors{};
+    std::vector<int64_t> buckets{};
+    for (auto it = _series.lower_bound(SeriesKey(garageId, INT32_MIN, INT32_MIN));
+        it != _series.end() && std::get<0>(it->first) == garageId; it++)
+    {
+        if ((level >= 0 && std::get<1>(it->first) != level)
+            || (spotType != SpotType::SPOT_NONE && std::get<2>(it->first) != spotType))
+        {
+            continue;
+        }
+        const Tier_t &tier = it->second.tiers[tier_index];
+        Cursor_t cursor = {&tier, 0, tier.baseFilled};
+        while (cursor.index < tier.size() && tier.at(cursor.index).timestamp < from)
+        {
+            cursor.carry = tier.at(cursor.index).filled;
+            cursor.index++;
+        }
+        for (size_t i = cursor.index; i < tier.size() && tier.at(i).timestamp < to; i++)
+        {
+            buckets.push_back(tier.at(i).timestamp);
+        }
+        cursors.push_back(cursor);
+    }
+    std::sort(buckets.begin(), buckets.end());
+    buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+
+    samples.reserve(buckets.size());
+    for (int64_t bucket : buckets)
+    {
+        OccupancySample_t total;
+        total.timestamp = bucket;
+        for (Cursor_t &cursor : cursors)
+        {
+            if (cursor.index < cursor.tier->size() && cursor.tier->at(cursor.index).timestamp == bucket)
+            {
+                const OccupancySample_t &sample = cursor.tier->at(cursor.index++);
+                total.filled += sample.filled;
+                total.minFilled += sample.minFilled;
+                total.maxFilled += sample.maxFilled;
+                cursor.carry = sample.filled;
+            }
+            else
+            {
+                total.filled += cursor.carry;
+                total.minFilled += cursor.carry;
+                total.maxFilled += cursor.carry;
+            }
+        }
+        samples.push_back(total);
+    }
+    return GarageRetCode::OK;
+}
+
+void OccupancyRecorder::ExportCsv(std::ostream &out, OccupancyResolution resolution) const
+{
+    uint tier_index = _tierIndex(resolution);
+    if (tier_index >= NUM_TIERS)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    out << "timestamp,garage_id,level,spot_type,filled,min_filled,max_filled\n";
+    for (const auto &entry : _series)
+    {
+        const Tier_t &tier = entry.second.tiers[tier_index];
+        for (size_t i = 0; i < tier.size(); i++)
+        {
+            const OccupancySample_t &sample = tier.at(i);
+            out << sample.timestamp << ','
+                << std::get<0>(entry.first) << ','
+                << std::get<1>(entry.first) << ','
+                << std::get<2>(entry.first) << ','
+                << sample.filled << ','
+                << sample.minFilled << ','
+                << sample.maxFilled << '\n';
+        }
+    }
+}
+
+void OccupancyRecorder::ExportBinary(std::ostream &out, OccupancyResolution resolution) const
+{
+    uint tier_index = _tierIndex(resolution);
+    if (tier_index >= NUM_TIERS)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    out.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    out.put(static_cast<char>(BINARY_VERSION));
+    writeVarint(out, resolution);
+    writeVarint(out, _series.size());
+    for (const auto &entry : _series)
+    {
+        const Tier_t &tier = entry.second.tiers[tier_index];
+        writeSigned(out, std::get<0>(entry.first));
+        writeSigned(out, std::get<1>(entry.first));
+        writeSigned(out, std::get<2>(entry.first));
+        writeSigned(out, tier.baseFilled);
+        writeVarint(out, tier.size());
+        // Bucket numbers and filled counts as deltas from the previous sample
+        int64_t prev_bucket = 0;
+        int prev_filled = tier.baseFilled;
+        for (size_t i = 0; i < tier.size(); i++)
+        {
+            const OccupancySample_t &sample = tier.at(i);
+            int64_t bucket = sample.timestamp / tier.resolution;
+            writeSigned(out, bucket - prev_bucket);
+            writeSigned(out, sample.filled - prev_filled);
+            writeVarint(out, sample.filled - sample.minFilled);
+            writeVarint(out, sample.maxFilled - sample.filled);
+            prev_bucket = bucket;
+            prev_filled = sample.filled;
+        }
+    }
+}
+
+GarageRetCode OccupancyRecorder::ImportBinary(std::istream &in)
+{
+    char magic[sizeof(BINARY_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), BINARY_MAGIC)
+        || in.get() != BINARY_VERSION)
+    {
+        return GarageRetCode::ERR_INVALID_ARGUMENTS;
+    }
+    uint64_t resolution;
+    uint64_t num_series;
+    if (!readVarint(in, resolution) || !readVarint(in, num_series)
+        || _tierIndex(static_cast<OccupancyResolution>(resolution)) >= NUM_TIERS)
+    {
+        return GarageRetCode::ERR_INVALID_ARGUMENTS;
+    }
+    uint tier_index = _tierIndex(static_cast<OccupancyResolution>(resolution));
+    const uint capacities[NUM_TIERS] = {_config.secondSamples, _config.minuteSamples, _config.hourSamples};
+
+    // Decode everything before touching the recorder, so a bad or truncated
+    //  input leaves it unchanged
+    typedef struct Imported_t {
+        Tier_t tier;
+        int filled;
+    } Imported_t;
+    std::map<SeriesKey, Imported_t> imported{};
+    for (uint64_t series_num = 0; series_num < num_series; series_num++)
+    {
+        int64_t garage_id, level, spot_type, base_filled;
+        uint64_t num_samples;
+        if (!readSigned(in, garage_id) || !readSigned(in, level) || !readSigned(in, spot_type)
+            || !readSigned(in, base_filled) || !readVarint(in, num_samples))
+        {
+            return GarageRetCode::ERR_INVALID_ARGUMENTS;
+        }
+        Imported_t &series = imported[SeriesKey(garage_id, level, spot_type)];
+        Tier_t &tier = series.tier;
+        tier.resolution = TIER_RESOLUTIONS[tier_index];
+        tier.capacity = capacities[tier_index];
+        tier.baseFilled = base_filled;
+        int64_t bucket = 0;
+        int filled = base_filled;
+        for (uint64_t i = 0; i < num_samples; i++)
+        {
+            int64_t bucket_delta, filled_delta;
+            uint64_t below, above;
+            if (!readSigned(in, bucket_delta) || !readSigned(in, filled_delta)
+                || !readVarint(in, below) || !readVarint(in, above))
+            {
+                return GarageRetCode::ERR_INVALID_ARGUMENTS;
+            }
+            bucket += bucket_delta;
+            filled += filled_delta;
+            OccupancySample_t sample;
+            sample.timestamp = bucket * tier.resolution;
+            sample.filled = filled;
+            sample.minFilled = filled - static_cast<int>(below);
+            sample.maxFilled = filled + static_cast<int>(above);
+            if (tier.capacity > 0U)
+            {
+                tier.push(sample);
+            }
+        }
+        series.filled = filled;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Series missing from the input keep no samples at this resolution
+    for (auto &entry : _series)
+    {
+        entry.second.tiers[tier_index] = Tier_t();
+        entry.second.tiers[tier_index].resolution = TIER_RESOLUTIONS[tier_index];
+        entry.second.tiers[tier_index].capacity = capacities[tier_index];
+    }
+    for (auto &entry : imported)
+    {
+        bool is_new = (_series.find(entry.first) == _series.end());
+        Series_t &series = _getSeries(std::get<0>(entry.first), std::get<1>(entry.first),
+            static_cast<SpotType>(std::get<2>(entry.first)));
+        series.tiers[tier_index] = std::move(entry.second.tier);
+        if (is_new)
+        {
+            series.filled = entry.second.filled;
+            series.seeded = true;
+        }
+    }
+    return GarageRetCode::OK;
+}
+
+size_t OccupancyRecorder::MemoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t bytes = 0;
+    for (const auto &entry : _series)
+    {
+        bytes += sizeof(entry);
+        for (const Tier_t &tier : entry.second.tiers)
+        {
+            bytes += tier.samples.capacity() * sizeof(OccupancySample_t);
+        }
+    }
+    return bytes;
+}
+
+OccupancyRecorder::Series_t &OccupancyRecorder::_getSeries(int garageId, int level, SpotType spotType)
+{
+    auto it = _series.find(SeriesKey(garageId, level, spotType));
+    if (it == _series.end())
+    {
+        Series_t series;
+        const uint capacities[NUM_TIERS] = {_config.secondSamples, _config.minuteSamples, _config.hourSamples};
+        for (uint i = 0; i < NUM_TIERS; i++)
+        {
+            series.tiers[i].resolution = TIER_RESOLUTIONS[i];
+            series.tiers[i].capacity = capacities[i];
+        }
+        it = _series.emplace(SeriesKey(garageId, level, spotType), std::move(series)).first;
+    }
+    return it->second;
+}
+
+void OccupancyRecorder::_record(Series_t &series, int filled)
+{
+    // The first value has nothing to change from
+    int prev_filled = series.seeded ? series.filled : filled;
+    series.filled = filled;
+    series.seeded = true;
+    int64_t now = _config.clock();
+    for (Tier_t &tier : series.tiers)
+    {
+        if (tier.capacity == 0U)
+        {
+            continue;
+        }
+        int64_t bucket = now - (now % tier.resolution);
+        // Changes within the latest bucket (or from a clock that went
+        //  backwards) update it in place
+        if (tier.size() > 0 && tier.back().timestamp >= bucket)
+        {
+            OccupancySample_t &sample = tier.back();
+            sample.filled = filled;
+            sample.minFilled = std::min(sample.minFilled, filled);
+            sample.maxFilled = std::max(sample.maxFilled, filled);
+        }
+        else
+        {
+            OccupancySample_t sample;
+            sample.timestamp = bucket;
+            sample.filled = filled;
+            sample.minFilled = std::min(prev_filled, filled);
+            sample.maxFilled = std::max(prev_filled, filled);
+            tier.push(sample);
+        }
+    }
+}
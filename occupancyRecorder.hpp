@@ -0,0 +1,141 @@
+/*
+ * Occupancy recorder definitions.
+ *
+ * Records the number of filled spots per garage, level and spot type over
+ *  time. Every change updates a per-second, per-minute and per-hour tier,
+ *  each a fixed size ring of buckets holding the last, min and max filled
+ *  count seen in the bucket, so memory stays bounded however long it runs.
+ *  Buckets without changes are not stored; readers carry the previous
+ *  value forward.
+ */
+#pragma once
+
+#include "garageApi.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+
+enum OccupancyResolution {
+    RESOLUTION_SECOND = 600,
+    RESOLUTION_MINUTE,
+    RESOLUTION_HOUR,
+};
+
+typedef struct OccupancySample_t {
+    int64_t timestamp   = 0;    // Start of the bucket, seconds since the epoch
+    int     filled      = 0;    // Filled spots at the end of the bucket
+    int     minFilled   = 0;
+    int     maxFilled   = 0;
+} OccupancySample_t;
+
+typedef struct OccupancyRecorderConfig_t {
+    uint secondSamples  = 600;  // 10 minutes
+    uint minuteSamples  = 1440; // 1 day
+    uint hourSamples    = 720;  // 30 days
+    // Seconds since the epoch; defaults to the system clock
+    std::function<int64_t()> clock{};
+} OccupancyRecorderConfig_t;
+
+class OccupancyRecorder
+{
+public:
+    OccupancyRecorder(OccupancyRecorderConfig_t config = {});
+
+    /**
+     * @return true once any occupancy has been recorded for the garage.
+     */
+    bool HasGarage(int garageId) const;
+    /**
+     * Record the current number of filled spots of one level and spot type.
+     */
+    void Set(int garageId, int level, SpotType spotType, int filled);
+    /**
+     * Record a change in the number of filled spots of one level and spot type.
+     */
+    void Adjust(int garageId, int level, SpotType spotType, int delta);
+    /**
+     * Forget everything recorded.
+     */
+    void Clear();
+
+    /**
+     * Populate the occupancy of a garage over a time range, summed over the
+     *  matching levels and spot types. One sample is returned per bucket in
+     *  which any matching series changed. Min and max are the sums of the
+     *  per-series min and max, so they bound the true range of the total.
+     *
+     * @param garageId ID of the requested parking garage.
+     * @param level Zero-based level to match, or -1 for every level.
+     * @param spotType Spot type to match, or SPOT_NONE for every type.
+     * @param resolution Tier to read.
+     * @param from Start of the range, seconds since the epoch, inclusive.
+     * @param to End of the range, seconds since the epoch, exclusive.
+     * @param samples (OUT) Cleared and populated with samples in time order.
+     * @return relevant return code.
+     */
+    GarageRetCode Query(int garageId, int level, SpotType spotType, OccupancyResolution resolution,
+        int64_t from, int64_t to, std::vector<OccupancySample_t> &samples) const;
+
+    /**
+     * Write one tier as CSV with the header
+     *  "timestamp,garage_id,level,spot_type,filled,min_filled,max_filled".
+     */
+    void ExportCsv(std::ostream &out, OccupancyResolution resolution) const;
+    /**
+     * Write one tier in a compact binary form: varint and delta encoded
+     *  samples, readable with ImportBinary.
+     */
+    void ExportBinary(std::ostream &out, OccupancyResolution resolution) const;
+    /**
+     * Replace one tier of every series with data written by ExportBinary.
+     *  Series missing from the input are left with no samples in that tier.
+     *  Nothing changes unless the whole input decodes.
+     *
+     * @return relevant return code.
+     */
+    GarageRetCode ImportBinary(std::istream &in);
+
+    /**
+     * @return approximate heap bytes used by recorded samples.
+     */
+    size_t MemoryUsage() const;
+
+private:
+    static const uint NUM_TIERS = 3;
+
+    typedef struct Tier_t {
+        int64_t resolution = 1;
+        uint capacity = 0;
+        uint head = 0;      // Oldest sample once the ring is full
+        int baseFilled = 0; // Filled count before the oldest stored sample
+        std::vector<OccupancySample_t> samples{};
+
+        size_t size() const { return samples.size(); }
+        const OccupancySample_t &at(size_t i) const { return samples[(head + i) % samples.size()]; }
+        OccupancySample_t &back() { return samples[(head + samples.size() - 1) % samples.size()]; }
+        void push(const OccupancySample_t &sample);
+    } Tier_t;
+
+    typedef struct Series_t {
+        int filled = 0;
+        bool seeded = false;    // False until the first value is recorded
+        Tier_t tiers[NUM_TIERS];
+    } Series_t;
+
+    // (garage id, level, spot type)
+    typedef std::tuple<int, int, int> SeriesKey;
+
+    static uint _tierIndex(OccupancyResolution resolution) { return resolution - RESOLUTION_SECOND; }
+    Series_t &_getSeries(int garageId, int level, SpotType spotType);
+    void    _record(Series_t &series, int filled);
+
+    OccupancyRecorderConfig_t _config;
+    mutable std::mutex _mutex;
+    std::map<SeriesKey, Series_t> _series;
+};
@@ -0,0 +1,512 @@
+#include "spotBitmap.hpp"
+
+#include <algorithm>
+
+
+SpotBitmap::const_iterator::const_iterator(const SpotBitmap *bitmap, size_t container):
+    _bitmap(bitmap),
+    _container(container)
+{
+    uint16_t low;
+    if (_container < _bitmap->_containers.size()
+        && _containerNext(_bitmap->_containers[_container], 0, low))
+    {
+        _value = (static_cast<int>(_bitmap->_containers[_container].key) << 16) | low;
+    }
+}
+
+SpotBitmap::const_iterator &SpotBitmap::const_iterator::operator++()
+{
+    const std::vector<Container> &containers = _bitmap->_containers;
+    uint16_t low;
+    if (_containerNext(containers[_container], (_value & 0xFFFF) + 1U, low))
+    {
+        _value = (_value & ~0xFFFF) | low;
+        return *this;
+    }
+    // Containers are never left empty, so the next one always has a first value
+    _container++;
+    _value = -1;
+    if (_container < containers.size() && _containerNext(containers[_container], 0, low))
+    {
+        _value = (static_cast<int>(containers[_container].key) << 16) | low;
+    }
+    return *this;
+}
+
+void SpotBitmap::add(int spotId)
+{
+    if (spotId < 0)
+    {
+        return;
+    }
+    Container &container = _getOrCreateContainer(static_cast<uint16_t>(spotId >> 16));
+    _containerAdd(container, static_cast<uint16_t>(spotId & 0xFFFF));
+}
+
+void SpotBitmap::remove(int spotId)
+{
+    if (spotId < 0)
+    {
+        return;
+    }
+    Container *container = _findContainer(static_cast<uint16_t>(spotId >> 16));
+    if (container == nullptr)
+    {
+        return;
+    }
+    _containerRemove(*container, static_cast<uint16_t>(spotId & 0xFFFF));
+    if (container->cardinality == 0)
+    {
+        _containers.erase(_containers.begin() + (container - _containers.data()));
+    }
+}
+
+bool SpotBitmap::contains(int spotId) const
+{
+    if (spotId < 0)
+    {
+        return false;
+    }
+    const Container *container = _findContainer(static_cast<uint16_t>(spotId >> 16));
+    return container != nullptr && _containerContains(*container, static_cast<uint16_t>(spotId & 0xFFFF));
+}
+
+size_t SpotBitmap::rank(int spotId) const
+{
+    if (spotId < 0)
+    {
+        return 0;
+    }
+    uint16_t key = static_cast<uint16_t>(spotId >> 16);
+    size_t count = 0;
+    for (const Container &container : _containers)
+    {
+        if (container.key < key)
+        {
+            count += container.cardinality;
+        }
+        else
+        {
+            if (container.key == key)
+            {
+                count += _containerRank(container, static_cast<uint16_t>(spotId & 0xFFFF));
+            }
+            break;
+        }
+    }
+    return count;
+}
+
+size_t SpotBitmap::cardinality() const
+{
+    size_t count = 0;
+    for (const Container &container : _containers)
+    {
+        count += container.cardinality;
+    }
+    return count;
+}
+
+void SpotBitmap::runOptimize()
+{
+    for (Container &container : _containers)
+    {
+        _shrink(container);
+    }
+}
+
+size_t SpotBitmap::memoryUsage() const
+{
+    size_t bytes = _containers.capacity() * sizeof(Container);
+    for (const Container &container : _containers)
+    {
+        bytes += container.values.capacity() * sizeof(uint16_t);
+        bytes += container.words.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+SpotBitmap SpotBitmap::operator&(const SpotBitmap &other) const
+{
+    SpotBitmap result;
+    auto a = _containers.begin();
+    auto b = other._containers.begin();
+    while (a != _containers.end() && b != other._containers.end())
+    {
+        if (a->key < b->key)
+        {
+            a++;
+        }
+        else if (b->key < a->key)
+        {
+            b++;
+        }
+        else
+        {
+            Container container = _intersect(*a, *b);
+            if (container.cardinality > 0)
+            {
+                result._containers.push_back(std::move(container));
+            }
+            a++;
+            b++;
+        }
+    }
+    return result;
+}
+
+SpotBitmap &SpotBitmap::operator&=(const SpotBitmap &other)
+{
+    *this = *this & other;
+    return *this;
+}
+
+bool SpotBitmap::operator==(const SpotBitmap &other) const
+{
+    if (cardinality() != other.cardinality())
+    {
+        return false;
+    }
+    return std::equal(begin(), end(), other.begin());
+}
+
+SpotBitmap::Container *SpotBitmap::_findContainer(uint16_t key)
+{
+    auto it = std::lower_bound(_containers.begin(), _containers.end(), key,
+        [](const Container &container, uint16_t k) { return container.key < k; });
+    return (it != _containers.end() && it->key == key) ? &*it : nullptr;
+}
+
+const SpotBitmap::Container *SpotBitmap::_findContainer(uint16_t key) const
+{
+    auto it = std::lower_bound(_containers.begin(), _containers.end(), key,
+        [](const Container &container, uint16_t k) { return container.key < k; });
+    return (it != _containers.end() && it->key == key) ? &*it : nullptr;
+}
+
+SpotBitmap::Container &SpotBitmap::_getOrCreateContainer(uint16_t key)
+{
+    auto it = std::lower_bound(_containers.begin(), _containers.end(), key,
+        [](const Container &container, uint16_t k) { return container.key < k; });
+    if (it == _containers.end() || it->key != key)
+    {
+        Container container;
+        container.key = key;
+        it = _containers.insert(it, std::move(container));
+    }
+    return *it;
+}
+
+bool SpotBitmap::_containerContains(const Container &container, uint16_t low)
+{
+    switch (container.kind)
+    {
+        case ContainerKind::ARRAY:
+            return std::binary_search(container.values.begin(), container.values.end(), low);
+        case ContainerKind::BITMAP:
+            return (container.words[low >> 6] >> (low & 63)) & 1U;
+        case ContainerKind::RUN:
+            for (size_t i = 0; i < container.values.size(); i += 2)
+            {
+                if (low < container.values[i])
+                {
+                    return false;
+                }
+                if (low <= container.values[i] + container.values[i + 1])
+                {
+                    return true;
+                }
+            }
+            return false;
+    }
+    return false;
+}
+
+size_t SpotBitmap::_containerRank(const Container &container, uint16_t low)
+{
+    size_t count = 0;
+    switch (container.kind)
+    {
+        case ContainerKind::ARRAY:
+            count = std::upper_bound(container.values.begin(), container.values.end(), low) - container.values.begin();
+            break;
+        case ContainerKind::BITMAP:
+            for (size_t word = 0; word < static_cast<size_t>(low >> 6); word++)
+            {
+                count += __builtin_popcountll(container.words[word]);
+            }
+            {
+                // Include the bit for low itself
+                uint64_t mask = ((low & 63) == 63) ? ~0ULL : ((1ULL << ((low & 63) + 1)) - 1);
+                count += __builtin_popcountll(container.words[low >> 6] & mask);
+            }
+            break;
+        case ContainerKind::RUN:
+            for (size_t i = 0; i < container.values.size() && container.values[i] <= low; i += 2)
+            {
+                uint32_t last = container.values[i] + container.values[i + 1];
+                count += std::min<uint32_t>(last, low) - container.values[i] + 1;
+            }
+            break;
+    }
+    return count;
+}
+
+bool SpotBitmap::_containerNext(const Container &container, uint32_t from, uint16_t &low)
+{
+    if (from > 0xFFFF)
+    {
+        return false;
+    }
+    switch (container.kind)
+    {
+        case ContainerKind::ARRAY:
+        {
+            auto it = std::lower_bound(container.values.begin(), container.values.end(), from);
+            if (it == container.values.end())
+            {
+                return false;
+            }
+            low = *it;
+            return true;
+        }
+        case ContainerKind::BITMAP:
+        {
+            size_t word = from >> 6;
+            uint64_t bits = container.words[word] & (~0ULL << (from & 63));
+            while (bits == 0)
+            {
+                if (++word == BITMAP_WORDS)
+                {
+                    return false;
+                }
+                bits = container.words[word];
+            }
+            low = static_cast<uint16_t>(word * 64 + __builtin_ctzll(bits));
+            return true;
+        }
+        case ContainerKind::RUN:
+            for (size_t i = 0; i < container.values.size(); i += 2)
+            {
+                uint32_t last = container.values[i] + container.values[i + 1];
+                if (from <= last)
+                {
+                    low = static_cast<uint16_t>(std::max<uint32_t>(from, container.values[i]));
+                    return true;
+                }
+            }
+            return false;
+    }
+    return false;
+}
+
+void SpotBitmap::_containerAdd(Container &container, uint16_t low)
+{
+    if (container.kind == ContainerKind::RUN)
+    {
+        if (_containerContains(container, low))
+        {
+            return;
+        }
+        _expandRuns(container);
+    }
+    if (container.kind == ContainerKind::ARRAY)
+    {
+        auto it = std::lower_bound(container.values.begin(), container.values.end(), low);
+        if (it != container.values.end() && *it == low)
+        {
+            return;
+        }
+        container.values.insert(it, low);
+        container.cardinality++;
+        if (container.cardinality > ARRAY_MAX_CARDINALITY)
+        {
+            _toBitmap(container);
+        }
+    }
+    else
+    {
+        uint64_t bit = 1ULL << (low & 63);
+        if ((container.words[low >> 6] & bit) == 0)
+        {
+            container.words[low >> 6] |= bit;
+            container.cardinality++;
+        }
+    }
+}
+
+void SpotBitmap::_containerRemove(Container &container, uint16_t low)
+{
+    if (!_containerContains(container, low))
+    {
+        return;
+    }
+    if (container.kind == ContainerKind::RUN)
+    {
+        _expandRuns(container);
+    }
+    if (container.kind == ContainerKind::ARRAY)
+    {
+        container.values.erase(std::lower_bound(container.values.begin(), container.values.end(), low));
+        container.cardinality--;
+    }
+    else
+    {
+        container.words[low >> 6] &= ~(1ULL << (low & 63));
+        container.cardinality--;
+        if (container.cardinality <= ARRAY_MAX_CARDINALITY)
+        {
+            _toArray(container);
+        }
+    }
+}
+
+void SpotBitmap::_containerValues(const Container &container, std::vector<uint16_t> &lows)
+{
+    lows.clear();
+    lows.reserve(container.cardinality);
+    uint16_t low;
+    uint32_t from = 0;
+    while (_containerNext(container, from, low))
+    {
+        lows.push_back(low);
+        from = low + 1U;
+    }
+}
+
+void SpotBitmap::_toArray(Container &container)
+{
+    std::vector<uint16_t> lows;
+    _containerValues(container, lows);
+    container.kind = ContainerKind::ARRAY;
+    container.values = std::move(lows);
+    container.words.clear();
+    container.words.shrink_to_fit();
+}
+
+void SpotBitmap::_toBitmap(Container &container)
+{
+    std::vector<uint16_t> lows;
+    _containerValues(container, lows);
+    container.kind = ContainerKind::BITMAP;
+    container.words.assign(BITMAP_WORDS, 0);
+    for (uint16_t low : lows)
+    {
+        container.words[low >> 6] |= 1ULL << (low & 63);
+    }
+    container.values.clear();
+    container.values.shrink_to_fit();
+}
+
+void SpotBitmap::_toRuns(Container &container)
+{
+    std::vector<uint16_t> lows;
+    _containerValues(container, lows);
+    std::vector<uint16_t> runs;
+    for (size_t i = 0; i < lows.size(); i++)
+    {
+        if (!runs.empty() && lows[i] == runs[runs.size() - 2] + runs.back() + 1U)
+        {
+            runs.back()++;
+        }
+        else
+        {
+            runs.push_back(lows[i]);
+            runs.push_back(0);
+        }
+    }
+    runs.shrink_to_fit();
+    container.kind = ContainerKind::RUN;
+    container.values = std::move(runs);
+    container.words.clear();
+    container.words.shrink_to_fit();
+}
+
+void SpotBitmap::_expandRuns(Container &container)
+{
+    if (container.cardinality > ARRAY_MAX_CARDINALITY)
+    {
+        _toBitmap(container);
+    }
+    else
+    {
+        _toArray(container);
+    }
+}
+
+void SpotBitmap::_shrink(Container &container)
+{
+    // Count runs without materializing them
+    size_t num_runs = 0;
+    uint16_t low;
+    uint32_t from = 0;
+    uint32_t prev = 0x10000;
+    while (_containerNext(container, from, low))
+    {
+        if (prev == 0x10000 || low != prev + 1)
+        {
+            num_runs++;
+        }
+        prev = low;
+        from = low + 1U;
+    }
+    size_t run_bytes = num_runs * 2 * sizeof(uint16_t);
+    size_t array_bytes = container.cardinality * sizeof(uint16_t);
+    size_t bitmap_bytes = BITMAP_WORDS * sizeof(uint64_t);
+    if (run_bytes < array_bytes && run_bytes < bitmap_bytes)
+    {
+        if (container.kind != ContainerKind::RUN)
+        {
+            _toRuns(container);
+        }
+    }
+    else if (container.kind == ContainerKind::RUN)
+    {
+        _expandRuns(container);
+    }
+    else
+    {
+        container.values.shrink_to_fit();
+    }
+}
+
+SpotBitmap::Container SpotBitmap::_intersect(const Container &a, const Container &b)
+{
+    Container result;
+    result.key = a.key;
+    if (a.kind == ContainerKind::BITMAP && b.kind == ContainerKind::BITMAP)
+    {
+        result.kind = ContainerKind::BITMAP;
+        result.words.resize(BITMAP_WORDS);
+        for (size_t word = 0; word < BITMAP_WORDS; word++)
+        {
+            result.words[word] = a.words[word] & b.words[word];
+            result.cardinality += __builtin_popcountll(result.words[word]);
+        }
+        if (result.cardinality <= ARRAY_MAX_CARDINALITY)
+        {
+            _toArray(result);
+        }
+        return result;
+    }
+    // Walk the smaller container and probe the larger one
+    const Container &small = (a.cardinality <= b.cardinality) ? a : b;
+    const Container &large = (a.cardinality <= b.cardinality) ? b : a;
+    uint16_t low;
+    uint32_t from = 0;
+    while (_containerNext(small, from, low))
+    {
+        if (_containerContains(large, low))
+        {
+            result.values.push_back(low);
+        }
+        from = low + 1U;
+    }
+    result.cardinality = result.values.size();
+    if (result.cardinality > ARRAY_MAX_CARDINALITY)
+    {
+        _toBitmap(result);
+    }
+    return result;
+}
@@ -0,0 +1,175 @@
+/*
+ * Spot bitmap definitions.
+ *
+ * Compressed set of parking spot ids. Ids are split into a 16 bit high key and
+ *  a 16 bit low value; each key owns one container holding its low values as a
+ *  sorted array, a plain bitmap or a list of runs, whichever is smallest.
+ *  Spot ids of a garage are mostly contiguous so they compress well into runs.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+
+class SpotBitmap
+{
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = int;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const int*;
+        using reference         = int;
+
+        const_iterator() = default;
+        int operator*() const { return _value; }
+        const_iterator &operator++();
+        const_iterator operator++(int) { const_iterator tmp = *this; ++(*this); return tmp; }
+        bool operator==(const const_iterator &other) const { return _container == other._container && _value == other._value; }
+        bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+    private:
+        friend class SpotBitmap;
+        const_iterator(const SpotBitmap *bitmap, size_t container);
+
+        const SpotBitmap *_bitmap = nullptr;
+        size_t _container = 0;
+        int _value = -1;
+    };
+
+    /**
+     * Add a spot id to the set. Negative ids are ignored.
+     *
+     * @param spotId ID of the parking spot.
+     */
+    void add(int spotId);
+    /**
+     * Remove a spot id from the set, if present.
+     *
+     * @param spotId ID of the parking spot.
+     */
+    void remove(int spotId);
+    /**
+     * @param spotId ID of the parking spot.
+     * @return true if the spot id is in the set.
+     */
+    bool contains(int spotId) const;
+    /**
+     * @param spotId ID of the parking spot.
+     * @return number of ids in the set that are less than or equal to spotId.
+     */
+    size_t rank(int spotId) const;
+    /**
+     * @return number of ids in the set.
+     */
+    size_t cardinality() const;
+    size_t size() const { return cardinality(); }
+    bool empty() const { return _containers.empty(); }
+    void clear() { _containers.clear(); }
+    /**
+     * Convert containers to run lists wherever that takes less memory.
+     *  Should be called once a set is fully populated.
+     */
+    void runOptimize();
+    /**
+     * @return approximate heap bytes used by the containers.
+     */
+    size_t memoryUsage() const;
+
+    SpotBitmap operator&(const SpotBitmap &other) const;
+    SpotBitmap &operator&=(const SpotBitmap &other);
+    bool operator==(const SpotBitmap &other) const;
+    bool operator!=(const SpotBitmap &other) const { return !(*this == other); }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, _containers.size()); }
+
+    /**
+     * Call func(int spotId) for every id in the set, in ascending order.
+     */
+    template <typename Func>
+    void forEach(Func func) const
+    {
+        for (const Container &container : _containers)
+        {
+            int high = static_cast<int>(container.key) << 16;
+            switch (container.kind)
+            {
+                case ContainerKind::ARRAY:
+                    for (uint16_t low : container.values)
+                    {
+                        func(high | low);
+                    }
+                    break;
+                case ContainerKind::BITMAP:
+                    for (size_t word = 0; word < container.words.size(); word++)
+                    {
+                        uint64_t bits = container.words[word];
+                        while (bits != 0)
+                        {
+                            int bit = __builtin_ctzll(bits);
+                            func(high | static_cast<int>(word * 64 + bit));
+                            bits &= bits - 1;
+                        }
+                    }
+                    break;
+                case ContainerKind::RUN:
+                    for (size_t i = 0; i < container.values.size(); i += 2)
+                    {
+                        int start = container.values[i];
+                        int last = start + container.values[i + 1];
+                        for (int low = start; low <= last; low++)
+                        {
+                            func(high | low);
+                        }
+                    }
+                    break;
+            }
+        }
+    }
+
+private:
+    enum class ContainerKind : uint8_t {
+        ARRAY,
+        BITMAP,
+        RUN,
+    };
+
+    typedef struct Container {
+        uint16_t key          = 0;
+        ContainerKind kind    = ContainerKind::ARRAY;
+        uint32_t cardinality  = 0;
+        // ARRAY: sorted low values. RUN: (start, length - 1) pairs.
+        std::vector<uint16_t> values{};
+        // BITMAP: 1024 words covering all 65536 low values.
+        std::vector<uint64_t> words{};
+    } Container;
+
+    static const uint32_t ARRAY_MAX_CARDINALITY = 4096;
+    static const size_t   BITMAP_WORDS = 1024;
+
+    Container       *_findContainer(uint16_t key);
+    const Container *_findContainer(uint16_t key) const;
+    Container       &_getOrCreateContainer(uint16_t key);
+
+    static bool     _containerContains(const Container &container, uint16_t low);
+    static size_t   _containerRank(const Container &container, uint16_t low);
+    static bool     _containerNext(const Container &container, uint32_t from, uint16_t &low);
+    static void     _containerAdd(Container &container, uint16_t low);
+    static void     _containerRemove(Container &container, uint16_t low);
+    static void     _containerValues(const Container &container, std::vector<uint16_t> &lows);
+    static void     _toArray(Container &container);
+    static void     _toBitmap(Container &container);
+    static void     _toRuns(Container &container);
+    static void     _expandRuns(Container &container);
+    static void     _shrink(Container &container);
+    static Container _intersect(const Container &a, const Container &b);
+
+    // Sorted by key
+    std::vector<Container> _containers{};
+};
@@ -0,0 +1,130 @@
+/*
+ * Vehicle class definitions.
+ *
+ * Describes which spot types each vehicle type can park in, how many
+ *  consecutive spots it takes and which spot types it prefers. Parking
+ *  validation and spot allocation are driven entirely by VEHICLE_CLASSES, so
+ *  a new vehicle or spot type only needs an enum value and a table entry.
+ */
+#pragma once
+
+#include "garageApi.hpp"
+
+#include <cstdint>
+
+
+// Spot types created by CreateGarage, one type per row
+constexpr SpotType GARAGE_SPOT_TYPES[] = {
+    SPOT_MOTORCYCLE,
+    SPOT_COMPACT,
+    SPOT_LARGE,
+};
+
+const uint MAX_PREFERENCES = 4;
+
+typedef struct VehicleClass_t {
+    VehicleType vehicleType     = VEHICLE_NONE;
+    uint32_t    allowedSpotTypes = 0;   // Bitmask of SpotTypeBit
+    uint        footprint       = 1;    // Consecutive spots in one row
+    SpotType    preferences[MAX_PREFERENCES] = {};  // Most preferred first, unused entries left zero.
+                                                    //  Only used when footprint is 1.
+} VehicleClass_t;
+
+constexpr uint32_t SpotTypeBit(SpotType spotType)
+{
+    return 1U << (spotType - SPOT_NONE);
+}
+
+constexpr uint32_t SpotTypeBits()
+{
+    return 0U;
+}
+
+template <typename... SpotTypes>
+constexpr uint32_t SpotTypeBits(SpotType spotType, SpotTypes... spotTypes)
+{
+    return SpotTypeBit(spotType) | SpotTypeBits(spotTypes...);
+}
+
+// Ordered by VehicleType, starting after VEHICLE_NONE
+constexpr VehicleClass_t VEHICLE_CLASSES[] = {
+    // Motorcycles can park anywhere, smallest spot first
+    {VEHICLE_MOTORCYCLE, SpotTypeBits(SPOT_MOTORCYCLE, SPOT_COMPACT, SPOT_LARGE), 1, {SPOT_MOTORCYCLE, SPOT_COMPACT, SPOT_LARGE}},
+    // Cars cannot park in motorcycle spots
+    {VEHICLE_CAR,        SpotTypeBits(SPOT_COMPACT, SPOT_LARGE),                  1, {SPOT_COMPACT, SPOT_LARGE}},
+    // Busses need 5 consecutive large spots in the same row
+    {VEHICLE_BUS,        SpotTypeBits(SPOT_LARGE),                                5, {SPOT_LARGE}},
+};
+
+constexpr uint NUM_VEHICLE_CLASSES = sizeof(VEHICLE_CLASSES) / sizeof(VEHICLE_CLASSES[0]);
+
+/**
+ * @param vehicleType Vehicle type to look up.
+ * @return the vehicle's class, or nullptr if the type is not in VEHICLE_CLASSES.
+ */
+constexpr const VehicleClass_t *FindVehicleClass(VehicleType vehicleType)
+{
+    return (vehicleType > VEHICLE_NONE && vehicleType - VEHICLE_NONE <= static_cast<int>(NUM_VEHICLE_CLASSES))
+        ? &VEHICLE_CLASSES[vehicleType - VEHICLE_NONE - 1]
+        : nullptr;
+}
+
+/**
+ * @return true if a vehicle of the type can park in a spot of the type.
+ */
+constexpr bool CanPark(VehicleType vehicleType, SpotType spotType)
+{
+    return FindVehicleClass(vehicleType) != nullptr
+        && (FindVehicleClass(vehicleType)->allowedSpotTypes & SpotTypeBit(spotType)) != 0;
+}
+
+template <VehicleType V>
+constexpr bool CanPark(SpotType spotType)
+{
+    static_assert(FindVehicleClass(V) != nullptr, "Vehicle type missing from VEHICLE_CLASSES");
+    return (FindVehicleClass(V)->allowedSpotTypes & SpotTypeBit(spotType)) != 0;
+}
+
+/**
+ * Pack a vehicle's preference order into 4 bits per spot type, so SQL can
+ *  rank a spot with ((ranks >> ((spot_type - SPOT_NONE) * 4)) & 15).
+ *  Spot types missing from the preferences rank last.
+ */
+constexpr uint64_t SpotPreferenceRanks(const VehicleClass_t &vehicleClass)
+{
+    uint64_t ranks = ~0ULL;
+    for (uint rank = 0; rank < MAX_PREFERENCES && vehicleClass.preferences[rank] > SPOT_NONE; rank++)
+    {
+        uint shift = (vehicleClass.preferences[rank] - SPOT_NONE) * 4;
+        ranks = (ranks & ~(15ULL << shift)) | (static_cast<uint64_t>(rank) << shift);
+    }
+    return ranks;
+}
+
+constexpr bool vehicleClassesValid()
+{
+    for (uint i = 0; i < NUM_VEHICLE_CLASSES; i++)
+    {
+        const VehicleClass_t &vehicle_class = VEHICLE_CLASSES[i];
+        if (vehicle_class.vehicleType != VEHICLE_NONE + 1 + static_cast<int>(i)
+            || vehicle_class.footprint == 0U
+            || vehicle_class.allowedSpotTypes == 0U)
+        {
+            return false;
+        }
+        for (uint rank = 0; rank < MAX_PREFERENCES && vehicle_class.preferences[rank] > SPOT_NONE; rank++)
+        {
+            SpotType preference = vehicle_class.preferences[rank];
+            if (preference - SPOT_NONE >= 16 || (vehicle_class.allowedSpotTypes & SpotTypeBit(preference)) == 0U)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(vehicleClassesValid(),
+    "VEHICLE_CLASSES must be ordered by VehicleType with a footprint, allowed spot types and allowed preferences");
+static_assert(CanPark<VEHICLE_MOTORCYCLE>(SPOT_MOTORCYCLE) && !CanPark<VEHICLE_CAR>(SPOT_MOTORCYCLE)
+    && CanPark<VEHICLE_BUS>(SPOT_LARGE) && !CanPark<VEHICLE_BUS>(SPOT_COMPACT), "Unexpected compatibility");